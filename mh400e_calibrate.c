@@ -0,0 +1,380 @@
+/*
+LinuxCNC component for controlling the MAHO MH400E gearbox.
+
+Copyright (C) 2018 Sergey 'Jin' Bostandzhyan <jin@mediatomb.cc>
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+as published by the Free Software Foundation; either version 2
+of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+*/
+
+/* Implementation of the shaft calibration, the shafts are moved via the
+ * shaft data of the gear shifting code. */
+
+#include "mh400e_calibrate.h"
+#include "mh400e_twitch.h"
+
+/* Travel position of the center mask, see gearshift_travel_position() */
+#define CALIBRATE_CENTER_POSITION   2
+
+/* Number of passes per shaft, pass -1 moves the shaft to its left end */
+#define CALIBRATE_PASSES            4
+
+/* group calibration data */
+static struct
+{
+    shaft_data_t *shafts[MH400E_NUM_SHAFTS];
+    int shaft;              /* index of the shaft that is being calibrated */
+    int pass;               /* current pass of this shaft */
+    bool slow;              /* motor speed of the current pass */
+    bool reverse;           /* motor direction of the current pass */
+    unsigned char end_mask; /* position where the current pass ends */
+    int start_position;     /* travel position where the pass started */
+    /* times in ns since the motor was energized */
+    long long elapsed;
+    long long leave_start;  /* shaft left the start position */
+    long long center_in;    /* center sensor became active */
+    long long center_out;   /* center sensor became inactive */
+    bool last_request;      /* last state of the calibrate pin */
+    hal_bit_t *active;
+    /* measurement results in us */
+    hal_u32_t *latency[MH400E_CALIBRATION_ENTRIES];
+    hal_u32_t *segment_lc[MH400E_CALIBRATION_ENTRIES];
+    hal_u32_t *segment_cr[MH400E_CALIBRATION_ENTRIES];
+    hal_u32_t *center_width[MH400E_CALIBRATION_ENTRIES];
+    hal_u32_t *travel[MH400E_CALIBRATION_ENTRIES];
+    long delay;
+    statefunc next;
+} g_calibrate_data;
+
+/* Call only once after gearbox_setup(), sets up the global calibration
+ * data structure */
+FUNCTION(calibrate_setup)
+{
+    int i;
+
+    for (i = 0; i < MH400E_NUM_SHAFTS; i++)
+    {
+        g_calibrate_data.shafts[i] = &(g_gearbox_data.shafts[i]);
+    }
+
+    for (i = 0; i < MH400E_CALIBRATION_ENTRIES; i++)
+    {
+        g_calibrate_data.latency[i] = &cal_latency(i);
+        g_calibrate_data.segment_lc[i] = &cal_segment_lc(i);
+        g_calibrate_data.segment_cr[i] = &cal_segment_cr(i);
+        g_calibrate_data.center_width[i] = &cal_center_width(i);
+        g_calibrate_data.travel[i] = &cal_travel(i);
+    }
+
+    g_calibrate_data.shaft = 0;
+    g_calibrate_data.pass = -1;
+    g_calibrate_data.last_request = calibrate;
+    g_calibrate_data.active = &calibrating;
+    g_calibrate_data.delay = 0;
+    g_calibrate_data.next = NULL;
+}
+
+static bool calibrate_requested(bool pin)
+{
+    bool result = pin && !g_calibrate_data.last_request;
+    g_calibrate_data.last_request = pin;
+    return result;
+}
+
+/* Helper to update delays, returns true if time has not elapsed. */
+static bool calibrate_wait_delay(long period)
+{
+    if ((period > 0) && (g_calibrate_data.delay > 0))
+    {
+        g_calibrate_data.delay = g_calibrate_data.delay - period;
+        return true;
+    }
+    g_calibrate_data.delay = 0;
+    return false;
+}
+
+/* Convert a measured duration to the us results, 0 marks a duration that
+ * could not be measured */
+static unsigned calibrate_us(long long from, long long to)
+{
+    if ((from < 0) || (to < from))
+    {
+        return 0;
+    }
+    return (hal_u32_t)((to - from) / 1000);
+}
+
+/* Store the measurements of the current pass */
+static void calibrate_store(void)
+{
+    int index = MH400E_CALIBRATION_INDEX(g_calibrate_data.shaft,
+                                         g_calibrate_data.slow,
+                                         g_calibrate_data.reverse);
+    /* the segment towards the center is passed first */
+    unsigned towards = calibrate_us(g_calibrate_data.leave_start,
+                                    g_calibrate_data.center_in);
+    unsigned away = calibrate_us(g_calibrate_data.center_out,
+                                 g_calibrate_data.elapsed);
+
+    if ((g_calibrate_data.leave_start < 0) ||
+        (g_calibrate_data.center_in < 0) ||
+        (g_calibrate_data.center_out < 0))
+    {
+        rtapi_print_msg(RTAPI_MSG_ERR, "mh400e_gearbox: WARNING: missed "
+                        "sensor changes while calibrating shaft %d!\n",
+                        g_calibrate_data.shaft);
+    }
+
+    *g_calibrate_data.latency[index] =
+        calibrate_us(0, g_calibrate_data.leave_start);
+    *g_calibrate_data.center_width[index] =
+        calibrate_us(g_calibrate_data.center_in, g_calibrate_data.center_out);
+    *g_calibrate_data.travel[index] = calibrate_us(0, g_calibrate_data.elapsed);
+
+    /* reverse moves from the left to the right end */
+    if (g_calibrate_data.reverse)
+    {
+        *g_calibrate_data.segment_lc[index] = towards;
+        *g_calibrate_data.segment_cr[index] = away;
+    }
+    else
+    {
+        *g_calibrate_data.segment_cr[index] = towards;
+        *g_calibrate_data.segment_lc[index] = away;
+    }
+}
+
+/* State functions */
+
+static void calibrate_prepare(long period);
+
+static void calibrate_finish(long period)
+{
+    shaft_data_t *shaft = g_calibrate_data.shafts[0];
+
+    if (calibrate_wait_delay(period))
+    {
+        g_calibrate_data.next = calibrate_finish;
+        return;
+    }
+
+    /* reverse and lowspeed pins are shared by all shafts */
+    if (*shaft->motor_reverse || *shaft->motor_slow)
+    {
+        *shaft->motor_reverse = false;
+        *shaft->motor_slow = false;
+        g_calibrate_data.delay = g_timing.generic_pin_interval;
+        g_calibrate_data.next = calibrate_finish;
+        return;
+    }
+
+    twitch_stop(period);
+
+    if (!twitch_stop_completed())
+    {
+        g_calibrate_data.delay = g_timing.twitch_keep_pin_off;
+        g_calibrate_data.next = calibrate_finish;
+        return;
+    }
+
+    *g_gearbox_data.start_shift = false;
+    *g_calibrate_data.active = false;
+    g_calibrate_data.next = NULL;
+
+    rtapi_print_msg(RTAPI_MSG_INFO, "mh400e_gearbox: shaft calibration "
+                    "finished\n");
+}
+
+/* Motor is running, record the sensor changes until we reach the end
+ * position of the current pass */
+static void calibrate_move(long period)
+{
+    shaft_data_t *shaft = g_calibrate_data.shafts[g_calibrate_data.shaft];
+    int position;
+
+    if (estop_on_spindle_running())
+    {
+        *shaft->motor_on = false;
+        g_calibrate_data.next = calibrate_finish;
+        return;
+    }
+
+    g_calibrate_data.elapsed += period;
+
+    position = gearshift_travel_position(shaft->current_mask);
+    if (position >= 0)
+    {
+        if ((g_calibrate_data.leave_start < 0) &&
+            (position != g_calibrate_data.start_position))
+        {
+            g_calibrate_data.leave_start = g_calibrate_data.elapsed;
+        }
+
+        if ((g_calibrate_data.center_in < 0) &&
+            (position == CALIBRATE_CENTER_POSITION))
+        {
+            g_calibrate_data.center_in = g_calibrate_data.elapsed;
+        }
+        else if ((g_calibrate_data.center_in >= 0) &&
+                 (g_calibrate_data.center_out < 0) &&
+                 (position != CALIBRATE_CENTER_POSITION))
+        {
+            g_calibrate_data.center_out = g_calibrate_data.elapsed;
+        }
+    }
+
+    if (shaft->current_mask == g_calibrate_data.end_mask)
+    {
+        *shaft->motor_on = false;
+
+        if (g_calibrate_data.pass >= 0)
+        {
+            calibrate_store();
+        }
+
+        g_calibrate_data.pass++;
+        if (g_calibrate_data.pass >= CALIBRATE_PASSES)
+        {
+            g_calibrate_data.pass = -1;
+            g_calibrate_data.shaft++;
+        }
+
+        g_calibrate_data.delay = g_timing.generic_pin_interval;
+        g_calibrate_data.next =
+            (g_calibrate_data.shaft < MH400E_NUM_SHAFTS) ?
+                calibrate_prepare : calibrate_finish;
+        return;
+    }
+
+    if (g_calibrate_data.elapsed > MH400E_CALIBRATION_TIMEOUT)
+    {
+        rtapi_print_msg(RTAPI_MSG_ERR, "mh400e_gearbox FATAL ERROR: shaft "
+                "%d did not reach its end position while calibrating, "
+                "triggering emergency stop!\n", g_calibrate_data.shaft);
+        *shaft->motor_on = false;
+        *g_gearbox_data.trigger_estop = true;
+        g_calibrate_data.next = calibrate_finish;
+        return;
+    }
+
+    g_calibrate_data.next = calibrate_move;
+}
+
+/* Set up the pins for the current pass and energize the motor */
+static void calibrate_prepare(long period)
+{
+    shaft_data_t *shaft = g_calibrate_data.shafts[g_calibrate_data.shaft];
+
+    if (calibrate_wait_delay(period))
+    {
+        g_calibrate_data.next = calibrate_prepare;
+        return;
+    }
+
+    if (estop_on_spindle_running())
+    {
+        g_calibrate_data.next = calibrate_finish;
+        return;
+    }
+
+    /* pass -1 brings the shaft to the left end at normal speed, then we
+     * go right and left at normal speed and right and left at low speed */
+    g_calibrate_data.slow = (g_calibrate_data.pass >= 2);
+    g_calibrate_data.reverse = (g_calibrate_data.pass >= 0) &&
+                               ((g_calibrate_data.pass % 2) == 0);
+    g_calibrate_data.end_mask = g_calibrate_data.reverse ?
+        MH400E_STAGE_POS_RIGHT : MH400E_STAGE_POS_LEFT;
+
+    if ((g_calibrate_data.pass < 0) &&
+        (shaft->current_mask == g_calibrate_data.end_mask))
+    {
+        g_calibrate_data.pass = 0;
+        g_calibrate_data.next = calibrate_prepare;
+        return;
+    }
+
+    if (*shaft->motor_reverse != g_calibrate_data.reverse)
+    {
+        *shaft->motor_reverse = g_calibrate_data.reverse;
+        g_calibrate_data.delay = g_timing.reverse_motor_interval;
+        g_calibrate_data.next = calibrate_prepare;
+        return;
+    }
+
+    if (*shaft->motor_slow != g_calibrate_data.slow)
+    {
+        *shaft->motor_slow = g_calibrate_data.slow;
+        g_calibrate_data.delay = g_timing.gear_stage_poll_interval;
+        g_calibrate_data.next = calibrate_prepare;
+        return;
+    }
+
+    g_calibrate_data.start_position =
+        gearshift_travel_position(shaft->current_mask);
+    g_calibrate_data.elapsed = 0;
+    g_calibrate_data.leave_start = -1;
+    g_calibrate_data.center_in = -1;
+    g_calibrate_data.center_out = -1;
+
+    *shaft->motor_on = true;
+    g_calibrate_data.next = calibrate_move;
+}
+
+static void calibrate_start(long period)
+{
+    if (estop_on_spindle_running())
+    {
+        return;
+    }
+
+    rtapi_print_msg(RTAPI_MSG_INFO, "mh400e_gearbox: starting shaft "
+                    "calibration\n");
+
+    timing_latch();
+
+    g_calibrate_data.shaft = 0;
+    g_calibrate_data.pass = -1;
+    *g_calibrate_data.active = true;
+
+    /* Make sure to leave 100ms between setting start_gear_shift to "on"
+     * and further operations */
+    g_calibrate_data.delay = g_timing.generic_pin_interval;
+    *g_gearbox_data.start_shift = true;
+
+    twitch_start(period);
+
+    g_calibrate_data.next = calibrate_prepare;
+}
+
+static void calibrate_handle(long period)
+{
+    twitch_handle(period);
+
+    if (g_calibrate_data.next != NULL)
+    {
+        g_calibrate_data.next(period);
+    }
+}
+
+static bool calibrate_in_progress(void)
+{
+    return g_calibrate_data.next != NULL;
+}
+
+static void calibrate_handle_estop(void)
+{
+    *g_calibrate_data.active = false;
+    g_calibrate_data.delay = 0;
+    g_calibrate_data.next = NULL;
+}
@@ -0,0 +1,68 @@
+/*
+LinuxCNC component for controlling the MAHO MH400E gearbox.
+
+Copyright (C) 2018 Sergey 'Jin' Bostandzhyan <jin@mediatomb.cc>
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+as published by the Free Software Foundation; either version 2
+of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+*/
+
+/* Shaft calibration: measures the real shaft travel times, so that the
+ * timings of the gearbox component and of the simulator can be based on
+ * the actual machine. */
+
+#ifndef __MH400E_CALIBRATE_H__
+#define __MH400E_CALIBRATE_H__
+
+#include <rtapi.h>
+
+#include "mh400e_common.h"
+#include "mh400e_gears.h"
+
+/* Call only once after gearbox_setup(), sets up the global calibration
+ * data structure */
+FUNCTION(calibrate_setup);
+
+/* Call this function once per thread cycle with the state of the calibrate
+ * pin, returns true if a new calibration has been requested. */
+static bool calibrate_requested(bool pin);
+
+/* Start the calibration, the spindle must be stopped and no gear shift may
+ * be in progress.
+ *
+ * Each shaft is first moved to its left position and then travels to the
+ * right and back to the left end position, once at normal and once at low
+ * motor speed. For each of these passes the latency until the shaft starts
+ * to move, the travel time between the end positions and the center, the
+ * time the center sensor is active and the overall travel time are
+ * recorded. */
+static void calibrate_start(long period);
+
+/* Call this function once per each thread cycle while the calibration is
+ * in progress. Incorporates the twitching handler. */
+static void calibrate_handle(long period);
+
+/* Returns true if a calibration is currently in progress */
+static bool calibrate_in_progress(void);
+
+/* Abort the calibration if an emergency stop was triggered, the gearbox
+ * pins are reset by gearbox_handle_estop(). */
+static void calibrate_handle_estop(void);
+
+/* really ugly way of keeping more order and splitting the sources,
+ * halcompile does not allow to link multipe source files together, so
+ * ultimately all sources need to be included by the .comp directly */
+#include "mh400e_calibrate.c"
+
+#endif//__MH400E_CALIBRATE_H__
@@ -28,6 +28,94 @@ typedef struct
     hal_bit_t *p[MH400E_PINS_IN_GROUP];
 } pin_group_t;
 
+/* Bit positions of the MESA 7i84 inputs and outputs, used with the packed
+ * interface. Each shaft occupies one pin group starting at the given bit. */
+#define MH400E_INPUT_BACKGEAR           0
+#define MH400E_INPUT_MIDRANGE           4
+#define MH400E_INPUT_INPUT_STAGE        8
+#define MH400E_INPUT_SPINDLE_STOPPED    19
+#define MH400E_NUM_SENSORS              (MH400E_NUM_SHAFTS * MH400E_PINS_IN_GROUP)
+
+#define MH400E_OUTPUT_MOTOR_LOWSPEED    0
+#define MH400E_OUTPUT_REDUCER_MOTOR     1
+#define MH400E_OUTPUT_MIDRANGE_MOTOR    2
+#define MH400E_OUTPUT_INPUT_STAGE_MOTOR 3
+#define MH400E_OUTPUT_REVERSE_DIRECTION 4
+#define MH400E_OUTPUT_START_GEAR_SHIFT  5
+#define MH400E_OUTPUT_TWITCH_CW         6
+#define MH400E_OUTPUT_TWITCH_CCW        7
+#define MH400E_NUM_OUTPUTS              8
+
+/* Outputs of the component that are not wired to the 7i84, they are
+ * buffered the same way but always go to their own pins */
+#define MH400E_OUTPUT_STOP_SPINDLE      8
+#define MH400E_OUTPUT_SPINDLE_AT_SPEED  9
+#define MH400E_OUTPUT_ESTOP             10
+#define MH400E_NUM_BUFFERED_OUTPUTS     11
+
+/* Gearbox descriptor: the shafts and the gears of the gearbox are described
+ * by the two lists below, the shaft data, sensor decoding, gear tables and
+ * the shift sequencing are generated from them at compile time. A related
+ * gearbox only needs its own lists and the matching pins in its .comp file.
+ *
+ * Shafts in the order of their sensor inputs, by default they are moved in
+ * the opposite order during a shift (input stage first):
+ *  X(name, first sensor input, motor output pin, motor output) */
+#define MH400E_GEARBOX_SHAFTS(X) \
+    X(BACKGEAR,    MH400E_INPUT_BACKGEAR,    reducer_motor, \
+                   MH400E_OUTPUT_REDUCER_MOTOR) \
+    X(MIDRANGE,    MH400E_INPUT_MIDRANGE,    midrange_motor, \
+                   MH400E_OUTPUT_MIDRANGE_MOTOR) \
+    X(INPUT_STAGE, MH400E_INPUT_INPUT_STAGE, input_stage_motor, \
+                   MH400E_OUTPUT_INPUT_STAGE_MOTOR)
+
+/* Gears in ascending rpm order starting with neutral, the positions are
+ * given in the order of the shaft list above. Neutral only cares about
+ * the MH400E_NEUTRAL_SHAFT, the other shafts are set to ANY.
+ *  X(rpm, backgear, midrange, input stage) */
+#define MH400E_GEARBOX_GEARS(X) \
+    X(0,    CENTER, ANY,    ANY)    \
+    X(80,   LEFT,   CENTER, CENTER) \
+    X(100,  LEFT,   CENTER, LEFT)   \
+    X(125,  LEFT,   CENTER, RIGHT)  \
+    X(160,  LEFT,   LEFT,   CENTER) \
+    X(200,  LEFT,   LEFT,   LEFT)   \
+    X(250,  LEFT,   LEFT,   RIGHT)  \
+    X(315,  LEFT,   RIGHT,  CENTER) \
+    X(400,  LEFT,   RIGHT,  LEFT)   \
+    X(500,  LEFT,   RIGHT,  RIGHT)  \
+    X(630,  RIGHT,  CENTER, CENTER) \
+    X(800,  RIGHT,  CENTER, LEFT)   \
+    X(1000, RIGHT,  CENTER, RIGHT)  \
+    X(1250, RIGHT,  LEFT,   CENTER) \
+    X(1600, RIGHT,  LEFT,   LEFT)   \
+    X(2000, RIGHT,  LEFT,   RIGHT)  \
+    X(2500, RIGHT,  RIGHT,  CENTER) \
+    X(3150, RIGHT,  RIGHT,  LEFT)   \
+    X(4000, RIGHT,  RIGHT,  RIGHT)
+
+/* the only shaft that has to be moved to reach neutral */
+#define MH400E_NEUTRAL_SHAFT    MH400E_SHAFT_BACKGEAR
+
+/* shaft indices, also used for the calibration parameters */
+typedef enum
+{
+#define MH400E_SHAFT_INDEX(name, input, motor, output) MH400E_SHAFT_##name,
+    MH400E_GEARBOX_SHAFTS(MH400E_SHAFT_INDEX)
+#undef MH400E_SHAFT_INDEX
+    MH400E_NUM_SHAFTS
+} mh400e_shaft_t;
+
+/* gear indices in the mh400e_gears array, i.e. MH400E_GEAR_INDEX_80 */
+typedef enum
+{
+#define MH400E_GEAR_INDEX(rpm, backgear, midrange, input_stage) \
+    MH400E_GEAR_INDEX_##rpm,
+    MH400E_GEARBOX_GEARS(MH400E_GEAR_INDEX)
+#undef MH400E_GEAR_INDEX
+    MH400E_GEAR_INDEX_END
+} mh400e_gear_index_t;
+
 /* description of a particular gear/speed setting */
 typedef struct
 {
@@ -40,7 +128,6 @@ typedef struct
  *                3        2       1      0
  * msb "left center" "center" "right" "left" lsb
  *
- * The table below provides the mask for all three shafts.
  * The helper macros should be used on an extracted 4 bit value.
  */
 #define MH400E_STAGE_IS_LEFT(mask)          (mask & 1)
@@ -48,30 +135,6 @@ typedef struct
 #define MH400E_STAGE_IS_CENTER(mask)        ((mask >> 2) & 1)
 #define MH400E_STAGE_IS_LEFT_CENTER(mask)   ((mask >> 3) & 1)
 
-/* lookup table from rpm to gearbox status pin values */
-static pair_t mh400e_gears[] =
-{  /* rpm   bitmask                msb 11 10 9 8 7 6 5 4 3 2 1 0 lsb */
-    { 0,    4       },              /* neutral           0 1 0 0 */
-    { 80,   1097    },              /*   0 1 0 0 0 1 0 0 1 0 0 1 */
-    { 100,  2377    },              /*   1 0 0 1 0 1 0 0 1 0 0 1 */
-    { 125,  585     },              /*   1 0 1 0 0 1 0 0 1 0 0 1 */
-    { 160,  1177    },              /*   0 1 0 0 1 0 0 1 1 0 0 1 */
-    { 200,  2457    },              /*   1 0 0 1 1 0 0 1 1 0 0 1 */
-    { 250,  665     },              /*   0 0 1 0 1 0 0 1 1 0 0 1 */
-    { 315,  1065    },              /*   0 1 0 0 0 0 1 0 1 0 0 1 */
-    { 400,  2345    },              /*   1 0 0 1 0 0 1 0 1 0 0 1 */
-    { 500,  553     },              /*   0 0 1 0 0 0 1 0 1 0 0 1 */
-    { 630,  1090    },              /*   0 1 0 0 0 1 0 0 0 0 1 0 */
-    { 800,  2370    },              /*   1 0 0 1 0 1 0 0 0 0 1 0 */
-    { 1000, 578     },              /*   0 0 1 0 0 1 0 0 0 0 1 0 */
-    { 1250, 1170    },              /*   0 1 0 0 1 0 0 1 0 0 1 0 */
-    { 1600, 2450    },              /*   1 0 0 1 1 0 0 1 0 0 1 0 */
-    { 2000, 658     },              /*   0 0 1 0 1 0 0 1 0 0 1 0 */
-    { 2500, 1058    },              /*   0 1 0 0 0 0 1 0 0 0 1 0 */
-    { 3150, 2338    },              /*   1 0 0 1 0 0 1 0 0 0 1 0 */
-    { 4000, 546     }               /*   0 0 1 0 0 0 1 0 0 0 1 0 */
-};
-
 /* Furthest CCW position, marked as "red" on the MAHO   */
 #define MH400E_STAGE_POS_LEFT               9   /* 1001 */
 
@@ -81,37 +144,134 @@ static pair_t mh400e_gears[] =
 /* Furthest CW position, marked as "yellow" on the MAHO */
 #define MH400E_STAGE_POS_RIGHT              2   /* 0010 */
 
+/* Shaft position that does not matter for a gear (neutral) */
+#define MH400E_STAGE_POS_ANY                0
+
+/* Masks seen while a shaft is moving between two positions, the left-center
+ * sensor stays active until the shaft reaches the center position */
+#define MH400E_STAGE_TRANSIT_LEFT_CENTER    8   /* 1000 */
+#define MH400E_STAGE_TRANSIT_CENTER_RIGHT   0   /* 0000 */
+
+/* The masks of all shafts are combined into one gear value, each shaft
+ * occupies one pin group in the order of MH400E_GEARBOX_SHAFTS */
+#define MH400E_SHAFT_SHIFT(shaft)   ((shaft) * MH400E_PINS_IN_GROUP)
+#define MH400E_SHAFT_MASK(value, shaft) \
+    (((value) >> MH400E_SHAFT_SHIFT(shaft)) & ((1 << MH400E_PINS_IN_GROUP) - 1))
+#define MH400E_GEAR_VALUE(backgear, midrange, input_stage) \
+    ((MH400E_STAGE_POS_##backgear << \
+            MH400E_SHAFT_SHIFT(MH400E_SHAFT_BACKGEAR)) | \
+     (MH400E_STAGE_POS_##midrange << \
+            MH400E_SHAFT_SHIFT(MH400E_SHAFT_MIDRANGE)) | \
+     (MH400E_STAGE_POS_##input_stage << \
+            MH400E_SHAFT_SHIFT(MH400E_SHAFT_INPUT_STAGE)))
+
+/* lookup table from rpm to gearbox status pin values, generated from the
+ * gearbox descriptor and never written to */
+static pair_t mh400e_gears[] =
+{
+#define MH400E_GEAR_ENTRY(rpm, backgear, midrange, input_stage) \
+    { rpm, MH400E_GEAR_VALUE(backgear, midrange, input_stage) },
+    MH400E_GEARBOX_GEARS(MH400E_GEAR_ENTRY)
+#undef MH400E_GEAR_ENTRY
+};
+
 /* total number of selectable gears including neutral */
-#define MH400E_NUM_GEARS        (sizeof(mh400e_gears)/sizeof(pair_t))
+#define MH400E_NUM_GEARS            MH400E_GEAR_INDEX_END
 /* max gear index in array */
-#define MH400E_MAX_GEAR_INDEX       MH400E_NUM_GEARS - 1
+#define MH400E_MAX_GEAR_INDEX       (MH400E_NUM_GEARS - 1)
 /* index of neutral gear */
 #define MH400E_NEUTRAL_GEAR_INDEX   0
-/* min spindle rpm > 0 supported by the MH400E */
-#define MH400E_MIN_RPM              80
 /* index of the first non 0 rpm setting in the gears array */
 #define MH400E_MIN_RPM_INDEX        1
-/* max spindle rpm supported by the MH400E */
-#define MH400E_MAX_RPM              4000
+/* min spindle rpm > 0 supported by the gearbox */
+#define MH400E_MIN_RPM              (mh400e_gears[MH400E_MIN_RPM_INDEX].key)
+/* max spindle rpm supported by the gearbox */
+#define MH400E_MAX_RPM              (mh400e_gears[MH400E_MAX_GEAR_INDEX].key)
 
-#define MH400E_TWITCH_KEEP_PIN_ON   800*1000000L /* 800ms in nanoseconds */
-#define MH400E_TWITCH_KEEP_PIN_OFF  200*1000000L /* 200ms in nanoseconds */
+/* The timings below are set via HAL parameters (see mh400e_timing.c), the
+ * parameters are latched at the beginning of each gear shift and clamped to
+ * the following limits. Maximum values must fit into a 32 bit long. */
 
-/* When shifting, poll the stage pins each 5ms. Picking a lower value here
- * to make sure that we do not "miss" and do not overshoot our target
- * position. */
-#define MH400E_GEAR_STAGE_POLL_INTERVAL 5*1000000L /* 5ms in nanoseconds */
+/* Time the twitch pins are kept on and off while twitching */
+#define MH400E_TWITCH_KEEP_PIN_ON_MIN       100*1000000L  /* 100ms in ns */
+#define MH400E_TWITCH_KEEP_PIN_ON_MAX       2000*1000000L /* 2s in ns */
+#define MH400E_TWITCH_KEEP_PIN_OFF_MIN      50*1000000L   /* 50ms in ns */
+#define MH400E_TWITCH_KEEP_PIN_OFF_MAX      2000*1000000L /* 2s in ns */
 
-/* If reverse direction needs to be activated, we have to wait 100ms before
- * we activate the motor after the reverse pin has been activated or
- * deactivated */
-#define MH400E_REVERSE_MOTOR_INTERVAL   100*1000000L /* 100ms in nanoseconds */
+/* Settle time between switching the lowspeed pin and energizing the shaft
+ * motor. Once the motor runs, the stage pins are checked in every cycle
+ * to make sure that we do not overshoot our target position. */
+#define MH400E_GEAR_STAGE_POLL_INTERVAL_MIN 1*1000000L    /* 1ms in ns */
+#define MH400E_GEAR_STAGE_POLL_INTERVAL_MAX 100*1000000L  /* 100ms in ns */
+
+/* If reverse direction needs to be activated, we have to wait at least
+ * 100ms before we activate the motor after the reverse pin has been
+ * activated or deactivated, the motor must have come to a stop by then */
+#define MH400E_REVERSE_MOTOR_INTERVAL_MIN   100*1000000L  /* 100ms in ns */
+#define MH400E_REVERSE_MOTOR_INTERVAL_MAX   2000*1000000L /* 2s in ns */
 
 /* Interval between all remaining pin operations related to gear shifting */
-#define MH400E_GENERIC_PIN_INTERVAL     100*1000000L /* 100ms in nanoseconds */
+#define MH400E_GENERIC_PIN_INTERVAL_MIN     10*1000000L   /* 10ms in ns */
+#define MH400E_GENERIC_PIN_INTERVAL_MAX     2000*1000000L /* 2s in ns */
+
+/* Time to wait for the spindle to get up to speed after a gear shift */
+#define MH400E_WAIT_SPINDLE_AT_SPEED_MIN    0L
+#define MH400E_WAIT_SPINDLE_AT_SPEED_MAX    2000*1000000L /* 2s in ns */
+
+/* Time constant of the low pass filter applied to the spindle encoder
+ * velocity for the standstill detection */
+#define MH400E_STANDSTILL_FILTER_TIME   20*1000000L /* 20ms in ns */
+
+/* Time the filtered velocity has to stay below the threshold */
+#define MH400E_STANDSTILL_HOLD_TIME_MIN 0L
+#define MH400E_STANDSTILL_HOLD_TIME_MAX 2000*1000000L /* 2s in ns */
+
+/* Number of most recent speed requests that are taken into account when
+ * predicting the next gear for idle pre-positioning */
+#define MH400E_PREDICT_WINDOW           16
+
+/* Time the spindle has to be stopped and idle before pre-positioning */
+#define MH400E_PREDICT_IDLE_TIME_MIN    1000*1000000LL       /* 1s in ns */
+#define MH400E_PREDICT_IDLE_TIME_MAX    3600*1000000000LL    /* 1h in ns */
+
+/* Calibration measurements are stored per shaft, motor speed and motor
+ * direction. Shafts are numbered in the order of their sensor inputs:
+ * backgear, midrange, input stage. */
+#define MH400E_CALIBRATION_ENTRIES      (MH400E_NUM_SHAFTS * 4)
+#define MH400E_CALIBRATION_INDEX(shaft, slow, reverse) \
+    ((shaft) * 4 + ((slow) ? 2 : 0) + ((reverse) ? 1 : 0))
+
+/* Give up calibrating if a shaft does not reach its end position in time */
+#define MH400E_CALIBRATION_TIMEOUT      10000*1000000LL /* 10s in ns */
+
+/* A shaft motor that runs longer than this factor times the calibrated
+ * travel time without reaching its target is considered to be stuck */
+#define MH400E_TRAVEL_WATCHDOG_FACTOR   2
+
+/* Sensor health statistics: sensor edges are only expected while the shaft
+ * motor runs and for a short while after it has been switched off, edges
+ * of the same sensor that follow each other within the bounce time are
+ * counted as bounces. */
+#define MH400E_HEALTH_SETTLE_TIME       200*1000000LL /* 200ms in ns */
+#define MH400E_HEALTH_BOUNCE_TIME       5*1000000LL   /* 5ms in ns */
+/* Number of moves the rolling time per segment baseline averages over */
+#define MH400E_HEALTH_BASELINE_MOVES    16
+/* A move that is slower than the baseline by this factor counts against
+ * the health score */
+#define MH400E_HEALTH_DRIFT_LIMIT       1.25
+/* Time constant in ns with which past events stop counting against the
+ * health score */
+#define MH400E_HEALTH_DECAY_TIME        (600*1000000000.0) /* 10min in ns */
+
+/* Layout version of the warm restart snapshot, increment whenever the
+ * meaning of the snapshot pins changes */
+#define MH400E_SNAPSHOT_VERSION         1
+
+/* Compile time check, halcompile needs literal pin array sizes, so the
+ * components use this to verify them against the tables above */
+#define MH400E_STATIC_ASSERT(cond, name) \
+    typedef char mh400e_static_assert_##name[(cond) ? 1 : -1]
 
-/* TODO: make this a module parameter */
-#define MH400E_WAIT_SPINDLE_AT_SPEED    500*1000000L /* 500ms in nanoseconds */
 /* generic state function */
 typedef void (*statefunc)(long period);
 
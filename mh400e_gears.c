@@ -35,12 +35,21 @@ typedef enum
 typedef struct
 {
     shaft_state_t state;
-    pin_group_t status_pins;
     hal_bit_t *motor_on;
     hal_bit_t *motor_reverse;
     hal_bit_t *motor_slow;
     unsigned char current_mask; /* auto updated via global variable */
     unsigned char target_mask;
+    int target_position;        /* travel position of the target mask */
+    bool want_reverse;          /* planned direction for this shift */
+    bool want_slow;             /* planned speed for this shift */
+    bool approach_slow;         /* speed for the final segment */
+    bool leave_reverse;         /* reverse pin state for the next shaft */
+    bool leave_slow;            /* lowspeed pin state for the next shaft */
+    bool last;                  /* last shaft in the sequence */
+    /* calibrated travel times in us, indexed by speed and direction */
+    hal_u32_t *travel_time[4];
+    long long run_time;         /* time in ns the motor has been running */
 } shaft_data_t;
 
 /* Group all data required for gearshifting */
@@ -51,11 +60,22 @@ static struct
     hal_bit_t *is_spindle_stopped;
     hal_bit_t *trigger_estop;
     hal_bit_t *notify_spindle_at_speed;
+    hal_s32_t *report_crossings;
+    hal_u32_t *count_restarts;
     bool spindle_on_before_shift;
-    shaft_data_t backgear;
-    shaft_data_t midrange;
-    shaft_data_t input_stage;
+    bool release_spindle;       /* stop_spindle was set by gearshift_start */
+    bool slow_only;             /* move all shafts at low speed */
+    pair_t *target_gear;        /* gear we are currently shifting to */
+    pair_t *resume_gear;        /* shift interrupted by an emergency stop */
+    pair_t preposition;         /* neutral with the other shafts moved */
+    bool resume_slow_only;
+    shaft_data_t shafts[MH400E_NUM_SHAFTS];
+    /* order in which the shafts are moved during the current shift */
+    shaft_data_t *sequence[MH400E_NUM_SHAFTS];
+    int sequence_length;
+    int sequence_step;
     long delay;
+    long pin_delay; /* time until the shared pins may be cleared */
     statefunc next;
 } g_gearbox_data;
 
@@ -63,146 +83,90 @@ static struct
  * switching*/
 FUNCTION(gearbox_setup)
 {
+    shaft_data_t *shaft;
+    int i, j;
+
     /* Populate data structures that will be used be the state functions
      * when shifting gears */
+    for (i = 0; i < MH400E_NUM_SHAFTS; i++)
+    {
+        shaft = &(g_gearbox_data.shafts[i]);
+        shaft->state = SHAFT_STATE_OFF;
+        shaft->motor_reverse =
+            io_output(MH400E_OUTPUT_REVERSE_DIRECTION, &reverse_direction);
+        shaft->motor_slow =
+            io_output(MH400E_OUTPUT_MOTOR_LOWSPEED, &motor_lowspeed);
+        shaft->current_mask = 0;
+        /* only the neutral shaft matters for neutral, don't care for
+         * the others */
+        shaft->target_mask = MH400E_SHAFT_MASK(
+                mh400e_gears[MH400E_NEUTRAL_GEAR_INDEX].value, i);
+        shaft->target_position = -1;
+        shaft->want_reverse = false;
+        shaft->want_slow = false;
+        shaft->approach_slow = false;
+        shaft->leave_reverse = false;
+        shaft->leave_slow = false;
+        shaft->last = false;
+        for (j = 0; j < 4; j++)
+        {
+            shaft->travel_time[j] = &shaft_travel_time(i * 4 + j);
+        }
+        shaft->run_time = 0;
+    }
+
+    /* each shaft has its own motor output */
+#define MH400E_SHAFT_MOTOR(name, input, motor, output) \
+    g_gearbox_data.shafts[MH400E_SHAFT_##name].motor_on = \
+        io_output(output, &motor);
+    MH400E_GEARBOX_SHAFTS(MH400E_SHAFT_MOTOR)
+#undef MH400E_SHAFT_MOTOR
 
-    g_gearbox_data.backgear.state = SHAFT_STATE_OFF;
-    /* Grabbing the pin pointers in EXTRA_SETUP did not work because the
-     * component did not seem to be fully initializedt there.
-     *
-     * Another issue:
-     * while output pins are defined as (*__comp_inst->pin_name) by
-     * halcompile, input pins are turned into (0+*__comp_inst->pin_name)
-     * which makes it impossible to get the pointers via the defines
-     * created by halcompile. Accessing the pin variable directly did not
-     * work due to macro expansion, only workaround I found was to temporarily
-     * disable the macros.
-     */
-    #pragma push_macro("reducer_left")
-    #pragma push_macro("reducer_right")
-    #pragma push_macro("reducer_center")
-    #pragma push_macro("reducer_left_center")
-    #undef reducer_left
-    #undef reducer_right
-    #undef reducer_center
-    #undef reducer_left_center
-	g_gearbox_data.backgear.status_pins = (pin_group_t)
-    {
-        __comp_inst->reducer_left,
-        __comp_inst->reducer_right,
-        __comp_inst->reducer_center,
-        __comp_inst->reducer_left_center
-    };
-    #pragma pop_macro("reducer_left")
-    #pragma pop_macro("reducer_right")
-    #pragma pop_macro("reducer_center")
-    #pragma pop_macro("reducer_left_center")
-    g_gearbox_data.backgear.motor_on = &reducer_motor;
-    g_gearbox_data.backgear.motor_reverse = &reverse_direction;
-    g_gearbox_data.backgear.motor_slow = &motor_lowspeed;
-    g_gearbox_data.backgear.current_mask = 0;
-    g_gearbox_data.backgear.target_mask =
-        mh400e_gears[MH400E_NEUTRAL_GEAR_INDEX].value; /* neutral */
-
-    g_gearbox_data.midrange.state = SHAFT_STATE_OFF;
-    #pragma push_macro("middle_left")
-    #pragma push_macro("middle_right")
-    #pragma push_macro("middle_center")
-    #pragma push_macro("middle_left_center")
-    #undef middle_left
-    #undef middle_right
-    #undef middle_center
-    #undef middle_left_center
-    g_gearbox_data.midrange.status_pins = (pin_group_t)
-    {
-        __comp_inst->middle_left,
-        __comp_inst->middle_right,
-        __comp_inst->middle_center,
-        __comp_inst->middle_left_center
-    };
-    #pragma pop_macro("middle_left")
-    #pragma pop_macro("middle_right")
-    #pragma pop_macro("middle_center")
-    #pragma pop_macro("middle_left_center")
-    g_gearbox_data.midrange.motor_on = &midrange_motor;
-    g_gearbox_data.midrange.motor_reverse = &reverse_direction;
-    g_gearbox_data.midrange.motor_slow = &motor_lowspeed;
-    g_gearbox_data.midrange.current_mask = 0;
-    g_gearbox_data.midrange.target_mask = 0; /* don't care for neutral */
-
-    g_gearbox_data.input_stage.state = SHAFT_STATE_OFF;
-    #pragma push_macro("input_left")
-    #pragma push_macro("input_right")
-    #pragma push_macro("input_center")
-    #pragma push_macro("input_left_center")
-    #undef input_left
-    #undef input_right
-    #undef input_center
-    #undef input_left_center
-    g_gearbox_data.input_stage.status_pins = (pin_group_t)
-    {
-        __comp_inst->input_left,
-        __comp_inst->input_right,
-        __comp_inst->input_center,
-        __comp_inst->input_left_center
-    };
-    #pragma pop_macro("input_left")
-    #pragma pop_macro("input_right")
-    #pragma pop_macro("input_center")
-    #pragma pop_macro("input_left_center")
-    g_gearbox_data.input_stage.motor_on = &input_stage_motor;
-    g_gearbox_data.input_stage.motor_reverse = &reverse_direction;
-    g_gearbox_data.input_stage.motor_slow = &motor_lowspeed;
-    g_gearbox_data.input_stage.current_mask = 0;
-    g_gearbox_data.input_stage.target_mask = 0; /* don't care for neutral */
-
-    #pragma push_macro("spindle_stopped")
-    #undef spindle_stopped
-    g_gearbox_data.is_spindle_stopped = __comp_inst->spindle_stopped;
-    #pragma pop_macro("spindle_stopped")
-    g_gearbox_data.do_stop_spindle = &stop_spindle;
+    /* the spindle stopped input is part of the input snapshot */
+    g_gearbox_data.is_spindle_stopped = io_spindle_stopped();
+
+    g_gearbox_data.do_stop_spindle =
+        io_output(MH400E_OUTPUT_STOP_SPINDLE, &stop_spindle);
     g_gearbox_data.spindle_on_before_shift = false;
-    g_gearbox_data.start_shift = &start_gear_shift;
-    g_gearbox_data.trigger_estop = &estop_out;
-    g_gearbox_data.notify_spindle_at_speed = &spindle_at_speed;
+    g_gearbox_data.release_spindle = false;
+    g_gearbox_data.slow_only = false;
+    g_gearbox_data.target_gear = NULL;
+    g_gearbox_data.resume_gear = NULL;
+    g_gearbox_data.resume_slow_only = false;
+    g_gearbox_data.start_shift =
+        io_output(MH400E_OUTPUT_START_GEAR_SHIFT, &start_gear_shift);
+    g_gearbox_data.trigger_estop = io_output(MH400E_OUTPUT_ESTOP, &estop_out);
+    g_gearbox_data.notify_spindle_at_speed =
+        io_output(MH400E_OUTPUT_SPINDLE_AT_SPEED, &spindle_at_speed);
+    g_gearbox_data.report_crossings = &planned_crossings;
+    g_gearbox_data.count_restarts = &shaft_restarts;
+    g_gearbox_data.sequence_length = 0;
+    g_gearbox_data.sequence_step = 0;
     g_gearbox_data.delay = 0;
+    g_gearbox_data.pin_delay = 0;
     g_gearbox_data.next = NULL;
 }
 
 static void gearshift_stop_spindle(void)
 {
-    g_gearbox_data.spindle_on_before_shift =
-        !(*g_gearbox_data.is_spindle_stopped);
+    g_gearbox_data.spindle_on_before_shift = !gearbox_spindle_stopped();
     *g_gearbox_data.do_stop_spindle = true;
 }
 
-/* combine values of all pins in a group to a bitmask */
-static unsigned char get_bitmask_from_pingroup(pin_group_t *group)
-{
-    unsigned char mask = 0;
-    int i;
-    for (i = 0; i < MH400E_PINS_IN_GROUP; i++)
-    {
-        mask |= *(group->p[i]) << i;
-    }
-
-    return mask;
-}
-
 /* Update current mask values for each shaft */
 static void update_current_pingroup_masks(void)
 {
-    g_gearbox_data.backgear.current_mask =
-        get_bitmask_from_pingroup(&g_gearbox_data.backgear.status_pins);
-    g_gearbox_data.midrange.current_mask =
-        get_bitmask_from_pingroup(&g_gearbox_data.midrange.status_pins);
-    g_gearbox_data.input_stage.current_mask =
-        get_bitmask_from_pingroup(&g_gearbox_data.input_stage.status_pins);
+    /* all masks come out of the input snapshot of this cycle */
+#define MH400E_SHAFT_SENSORS(name, input, motor, output) \
+    g_gearbox_data.shafts[MH400E_SHAFT_##name].current_mask = \
+        io_sensor_group(input);
+    MH400E_GEARBOX_SHAFTS(MH400E_SHAFT_SENSORS)
+#undef MH400E_SHAFT_SENSORS
 }
 
 static bool estop_on_spindle_running(void)
 {
-    if (!*g_gearbox_data.is_spindle_stopped)
+    if (!gearbox_spindle_stopped())
     {
         /* This is an invalid condition, spindle must be stopped if we are
          * shifting and we tested for it before we started.
@@ -211,6 +175,10 @@ static bool estop_on_spindle_running(void)
          * it will trigger our handler. */
         rtapi_print_msg(RTAPI_MSG_ERR, "mh400e_gearbox FATAL ERROR: detected "
                 "running spindle while shifting, triggering emergency stop!\n");
+        if (!*g_gearbox_data.trigger_estop)
+        {
+            stats_spindle_estop();
+        }
         *g_gearbox_data.trigger_estop = true;
         return true;
     }
@@ -221,29 +189,50 @@ static bool estop_on_spindle_running(void)
 /* Combine masks from each pin group to a value representing the current
  * gear setting. A return of NULL means that a corresponding value could
  * not be found, which may indicate a gearshift being in progress- */
-static pair_t* get_current_gear(tree_node_t *tree)
+static pair_t* get_current_gear(void)
 {
-    tree_node_t *result;
-
-    unsigned combined = (g_gearbox_data.input_stage.current_mask << 8) |
-                        (g_gearbox_data.midrange.current_mask << 4) |
-                         g_gearbox_data.backgear.current_mask;
+    unsigned combined = 0;
+    int i;
 
     /* special case: ignore all other bits for neutral */
-    if (g_gearbox_data.backgear.current_mask ==
-            mh400e_gears[MH400E_NEUTRAL_GEAR_INDEX].value)
+    if (g_gearbox_data.shafts[MH400E_NEUTRAL_SHAFT].current_mask ==
+            MH400E_SHAFT_MASK(mh400e_gears[MH400E_NEUTRAL_GEAR_INDEX].value,
+                              MH400E_NEUTRAL_SHAFT))
     {
         return &(mh400e_gears[MH400E_NEUTRAL_GEAR_INDEX]);
     }
 
-    result = tree_search(tree, combined);
-    if (result != NULL)
+    for (i = 0; i < MH400E_NUM_SHAFTS; i++)
+    {
+        combined |= g_gearbox_data.shafts[i].current_mask <<
+                    MH400E_SHAFT_SHIFT(i);
+    }
+
+    /* the gear values are constants, so the compiler can turn this into a
+     * search without any table lookups */
+    switch (combined)
     {
-        return &(mh400e_gears[result->value]);
+#define MH400E_GEAR_CASE(rpm, backgear, midrange, input_stage) \
+        case MH400E_GEAR_VALUE(backgear, midrange, input_stage): \
+            return &(mh400e_gears[MH400E_GEAR_INDEX_##rpm]);
+        MH400E_GEARBOX_GEARS(MH400E_GEAR_CASE)
+#undef MH400E_GEAR_CASE
     }
     return NULL;
 }
 
+static int get_gear_index(pair_t *gear)
+{
+    /* Pre-positioning keeps the gearbox in neutral, but moves the other
+     * shafts, it must not be mistaken for a shift to neutral */
+    if ((gear == NULL) || (gear == &(g_gearbox_data.preposition)))
+    {
+        return -1;
+    }
+
+    return (int)(gear - mh400e_gears);
+}
+
 /* Helper to update delays, returns true if time has not elapsed. */
 static bool gearshift_wait_delay(long period)
 {
@@ -295,6 +284,72 @@ static bool gearshift_need_reverse(unsigned char target_mask,
     return true;
 }
 
+/* Translate a shaft mask to its position along the shaft travel, counting
+ * from the furthest left/CW end (0) to the furthest right/CCW end. Masks
+ * that can not be seen on a healthy shaft will return -1.
+ *
+ *  left    left-center    center    center-right    right
+ *  1001 -> 1000        -> 0100   -> 0000         -> 0010
+ */
+static int gearshift_travel_position(unsigned char mask)
+{
+    switch (mask)
+    {
+        case MH400E_STAGE_POS_LEFT:
+            return 0;
+        case MH400E_STAGE_TRANSIT_LEFT_CENTER:
+            return 1;
+        case MH400E_STAGE_POS_CENTER:
+            return 2;
+        case MH400E_STAGE_TRANSIT_CENTER_RIGHT:
+            return 3;
+        case MH400E_STAGE_POS_RIGHT:
+            return 4;
+        default:
+            return -1;
+    }
+}
+
+/* Plan the shaft movement from the current to the target mask: the shaft
+ * travels between two end stops, so the shortest way is always the one
+ * that moves us towards the target position. Sets the reverse parameter
+ * accordingly and returns the number of sensor mask changes we expect
+ * to see on the way.
+ *
+ * If the current mask can not be decoded (i.e. bouncing or defective
+ * sensors), we fall back to gearshift_need_reverse() and return -1. */
+static int gearshift_plan_travel(unsigned char target_mask,
+                                 unsigned char current_mask, bool *reverse)
+{
+    int target = gearshift_travel_position(target_mask);
+    int current = gearshift_travel_position(current_mask);
+
+    if ((target < 0) || (current < 0))
+    {
+        *reverse = gearshift_need_reverse(target_mask, current_mask);
+        return -1;
+    }
+
+    /* right/CCW is reverse */
+    *reverse = (target > current);
+    return *reverse ? target - current : current - target;
+}
+
+
+/* Check if the shaft is one segment or less away from its target position,
+ * a mask that can not be decoded is treated as being close. */
+static bool gearshift_approaching(shaft_data_t *shaft)
+{
+    int current = gearshift_travel_position(shaft->current_mask);
+
+    if ((current < 0) || (shaft->target_position < 0))
+    {
+        return true;
+    }
+
+    return (current - shaft->target_position <= 1) &&
+           (shaft->target_position - current <= 1);
+}
 
 /* State functions */
 
@@ -309,6 +364,21 @@ static bool gearshift_protect(shaft_data_t *shaft)
         return false;
     }
 
+    /* We know where we want to go, so we can detect if the shaft moved past
+     * the target long before it hits the end stop. */
+    if (shaft->target_position >= 0)
+    {
+        int current = gearshift_travel_position(shaft->current_mask);
+        if ((current >= 0) &&
+            ((*shaft->motor_reverse && (current > shaft->target_position)) ||
+            (!*shaft->motor_reverse && (current < shaft->target_position))))
+        {
+            rtapi_print_msg(RTAPI_MSG_ERR, "mh400e_gearbox: WARNING: "
+                        "shaft motor moved past its target position!\n");
+            return true;
+        }
+    }
+
     if (*shaft->motor_reverse)
     {
         /* If we move to the left/CW and we reached the furthest left position
@@ -348,6 +418,40 @@ static bool gearshift_protect(shaft_data_t *shaft)
     return true;
 }
 
+/* Shaft travel watchdog: if the travel times have been calibrated, a motor
+ * that runs much longer than it would take the shaft to travel from one end
+ * to the other indicates a stuck shaft. Keeps the motor off and triggers an
+ * emergency stop in this case, returns true if the watchdog has fired. */
+static bool gearshift_watchdog(shaft_data_t *shaft, long period)
+{
+    long long limit = *shaft->travel_time[MH400E_CALIBRATION_INDEX(0,
+                            *shaft->motor_slow, *shaft->motor_reverse)];
+
+    if (*shaft->motor_on)
+    {
+        shaft->run_time += period;
+    }
+
+    limit = limit * 1000 * MH400E_TRAVEL_WATCHDOG_FACTOR;
+    if ((limit == 0) || (shaft->run_time <= limit))
+    {
+        return false;
+    }
+
+    if (*shaft->motor_on)
+    {
+        rtapi_print_msg(RTAPI_MSG_ERR, "mh400e_gearbox FATAL ERROR: shaft "
+                "did not reach its target within the calibrated travel "
+                "time, triggering emergency stop!\n");
+        *shaft->motor_on = false;
+    }
+
+    /* We expect that estop_out will be looped back to us so that it
+     * will trigger our handler. */
+    *g_gearbox_data.trigger_estop = true;
+    return true;
+}
+
 /* Generic function that has the exact same logic, valid for all of the 
  * three shafts. */
 static void gearshift_stage(shaft_data_t *shaft, statefunc me, statefunc next,
@@ -358,6 +462,14 @@ static void gearshift_stage(shaft_data_t *shaft, statefunc me, statefunc next,
         return;
     }
 
+    /* While the shaft motor is running we must not wait for anything: the
+     * target and end positions are checked in every cycle, so that the
+     * motor is cut in the very cycle the sensors report them. */
+    if ((shaft->state == SHAFT_STATE_ON) && *shaft->motor_on)
+    {
+        g_gearbox_data.delay = 0;
+    }
+
     if (gearshift_wait_delay(period))
     {
         g_gearbox_data.next = me;
@@ -374,13 +486,25 @@ static void gearshift_stage(shaft_data_t *shaft, statefunc me, statefunc next,
         }
         else
         {
+            bool reverse;
+            int crossings = gearshift_plan_travel(shaft->target_mask,
+                                                  shaft->current_mask,
+                                                  &reverse);
             shaft->state = SHAFT_STATE_ON;
+            shaft->run_time = 0;
+            shaft->target_position =
+                gearshift_travel_position(shaft->target_mask);
+            if (crossings > 0)
+            {
+                *g_gearbox_data.report_crossings += crossings;
+            }
 
-            if (gearshift_need_reverse(shaft->target_mask,
-                                       shaft->current_mask))
+            /* The previous shaft might have left the reverse pin in the
+             * state that we need, so only wait if we had to change it */
+            if (*shaft->motor_reverse != reverse)
             {
-                *shaft->motor_reverse = true;
-                g_gearbox_data.delay = MH400E_REVERSE_MOTOR_INTERVAL;
+                *shaft->motor_reverse = reverse;
+                g_gearbox_data.delay = g_timing.reverse_motor_interval;
             }
             g_gearbox_data.next = me;
         }
@@ -390,42 +514,57 @@ static void gearshift_stage(shaft_data_t *shaft, statefunc me, statefunc next,
         /* Did we reach the desired position? */
         if (shaft->current_mask == shaft->target_mask)
         {
+            bool reversed = false;
+
             if (*shaft->motor_on)
             {
                 /* De-energize the shaft motor */
                 *shaft->motor_on = false;
             }
-            else
+            else if (!shaft->last &&
+                     (*shaft->motor_reverse != shaft->leave_reverse))
             {
                 /* Second time we enter this state the motor will be off,
                  * that means that we already did the waiting that may have
-                 * been set in the "if" below. If reverse direction was
-                 * not active originally, then this does nothing */
-                *shaft->motor_reverse = false;
+                 * been set in the "if" below. If the reverse pin is already
+                 * in the state the next shaft needs, then there is nothing
+                 * to do. */
+                *shaft->motor_reverse = shaft->leave_reverse;
+                reversed = true;
             }
 
-            /* If reverse direction has been set, disable it in 100ms */
-            if (*shaft->motor_reverse)
+            /* The last shaft leaves the shared pins to gearshift_stop(),
+             * which clears them while the spindle is being released. The
+             * spindle is not released before the motor had time to settle
+             * either. */
+            if (shaft->last)
             {
-                g_gearbox_data.delay = MH400E_GENERIC_PIN_INTERVAL;
-                g_gearbox_data.next = me;
+                shaft->state = SHAFT_STATE_OFF;
+                g_gearbox_data.pin_delay = g_timing.generic_pin_interval;
+                g_gearbox_data.delay = g_timing.generic_pin_interval;
+                g_gearbox_data.next = next;
                 return;
             }
-            else
-            {
-                *shaft->motor_slow = false;
-            }
-          
-            if (*shaft->motor_slow)
+
+            /* If reverse direction needs to be changed, do it in 100ms */
+            if (*shaft->motor_reverse != shaft->leave_reverse)
             {
-                g_gearbox_data.delay = MH400E_GENERIC_PIN_INTERVAL;
+                g_gearbox_data.delay = g_timing.generic_pin_interval;
                 g_gearbox_data.next = me;
                 return;
             }
 
-            /* We are done here, proceed to the next stage */
+            *shaft->motor_slow = shaft->leave_slow;
+
+            /* We are done here, proceed to the next stage. The next shaft
+             * motor must not be energized before the reverse pin settled. */
             shaft->state = SHAFT_STATE_OFF;
-            g_gearbox_data.delay = MH400E_GENERIC_PIN_INTERVAL;
+            g_gearbox_data.delay = g_timing.generic_pin_interval;
+            if (reversed && (g_timing.reverse_motor_interval >
+                             g_gearbox_data.delay))
+            {
+                g_gearbox_data.delay = g_timing.reverse_motor_interval;
+            }
             g_gearbox_data.next = next;
         }
         else
@@ -436,20 +575,37 @@ static void gearshift_stage(shaft_data_t *shaft, statefunc me, statefunc next,
              * measure to prevent hardware damage. The function will
              * immediately stop the motor and trigger an emergency stop if this
              * error condition is detected. */
+            if (gearshift_watchdog(shaft, period))
+            {
+                g_gearbox_data.next = me;
+                return;
+            }
+
             if (gearshift_protect(shaft))
             {
                 *shaft->motor_on = false;
                 shaft->state = SHAFT_STATE_RESTART;
-                g_gearbox_data.delay = MH400E_REVERSE_MOTOR_INTERVAL;
+                (*g_gearbox_data.count_restarts)++;
+                g_gearbox_data.delay = g_timing.reverse_motor_interval;
                 g_gearbox_data.next = me;
                 return;
             }
 
-            /* Going to the center requres lowering the motor speed */
-            if (MH400E_STAGE_IS_CENTER(shaft->target_mask) && 
-                !(*shaft->motor_slow))
+            /* Going to the center requres lowering the motor speed, but
+             * only for the final segment: the shaft runs at full speed
+             * until it enters the segment next to its target. The motor
+             * keeps running while we switch. */
+            if (shaft->approach_slow && !shaft->want_slow &&
+                gearshift_approaching(shaft))
             {
-                *shaft->motor_slow = true;
+                shaft->want_slow = true;
+            }
+
+            /* The previous shaft might have left the pin in a different
+             * state */
+            if (*shaft->motor_slow != shaft->want_slow)
+            {
+                *shaft->motor_slow = shaft->want_slow;
             }
             else if (!(*shaft->motor_on))
             {
@@ -457,7 +613,9 @@ static void gearshift_stage(shaft_data_t *shaft, statefunc me, statefunc next,
                 *shaft->motor_on = true;
             }
 
-            g_gearbox_data.delay = MH400E_GEAR_STAGE_POLL_INTERVAL;
+            /* Give the lowspeed pin time to settle before the motor gets
+             * energized, this delay is skipped once the motor runs */
+            g_gearbox_data.delay = g_timing.gear_stage_poll_interval;
             g_gearbox_data.next = me;
         }
     }
@@ -469,7 +627,7 @@ static void gearshift_stage(shaft_data_t *shaft, statefunc me, statefunc next,
           if (*shaft->motor_reverse)
           {
               *shaft->motor_reverse = false;
-              g_gearbox_data.delay = MH400E_GENERIC_PIN_INTERVAL;
+              g_gearbox_data.delay = g_timing.generic_pin_interval;
               g_gearbox_data.next = me;
               return;
           }
@@ -477,7 +635,7 @@ static void gearshift_stage(shaft_data_t *shaft, statefunc me, statefunc next,
           if (*shaft->motor_slow)
           {
               *shaft->motor_slow = false;
-              g_gearbox_data.delay = MH400E_GENERIC_PIN_INTERVAL;
+              g_gearbox_data.delay = g_timing.generic_pin_interval;
           }
 
           /* Going back to the OFF state will retrigger the shift logic for
@@ -487,8 +645,44 @@ static void gearshift_stage(shaft_data_t *shaft, statefunc me, statefunc next,
     }
 }
 
+/* Clear the shared reverse and lowspeed pins once all shaft motors are off
+ * and the pins had time to settle after the last motor was switched off.
+ * Returns true once both pins are off. */
+static bool gearshift_clear_pins(long period)
+{
+    int i;
+
+    for (i = 0; i < MH400E_NUM_SHAFTS; i++)
+    {
+        if (*g_gearbox_data.shafts[i].motor_on)
+        {
+            return false;
+        }
+    }
+
+    if ((period > 0) && (g_gearbox_data.pin_delay > 0))
+    {
+        g_gearbox_data.pin_delay = g_gearbox_data.pin_delay - period;
+        return false;
+    }
+    g_gearbox_data.pin_delay = 0;
+
+    /* There are no separate pins for each shaft, see
+     * gearbox_handle_estop() */
+    *g_gearbox_data.shafts[0].motor_reverse = false;
+    *g_gearbox_data.shafts[0].motor_slow = false;
+    return true;
+}
+
+/* Finish the shift. Once all shaft motors are off, the remaining steps do
+ * not depend on each other and run in parallel: the shared pins are cleared
+ * after they had time to settle, while twitching is stopped and the spindle
+ * is released and brought back up to speed. We are done when both paths
+ * have completed. */
 static void gearshift_stop(long period)
 {
+    bool pins_cleared = gearshift_clear_pins(period);
+
     if (gearshift_wait_delay(period))
     {
         g_gearbox_data.next = gearshift_stop;
@@ -499,7 +693,7 @@ static void gearshift_stop(long period)
 
     if (!twitch_stop_completed())
     {
-        g_gearbox_data.delay = MH400E_TWITCH_KEEP_PIN_OFF;
+        g_gearbox_data.delay = g_timing.twitch_keep_pin_off;
         g_gearbox_data.next = gearshift_stop;
         return;
     }
@@ -508,10 +702,16 @@ static void gearshift_stop(long period)
     {
         *g_gearbox_data.start_shift = false;
 
+        if (g_gearbox_data.release_spindle)
+        {
+            *g_gearbox_data.do_stop_spindle = false;
+            g_gearbox_data.release_spindle = false;
+        }
+
         if (g_gearbox_data.spindle_on_before_shift)
         {
             *g_gearbox_data.do_stop_spindle = false;
-            g_gearbox_data.delay = MH400E_WAIT_SPINDLE_AT_SPEED;
+            g_gearbox_data.delay = g_timing.wait_spindle_at_speed;
             g_gearbox_data.next = gearshift_stop;
             return;
         }
@@ -520,29 +720,198 @@ static void gearshift_stop(long period)
     if (g_gearbox_data.spindle_on_before_shift)
     {
         *g_gearbox_data.notify_spindle_at_speed = true;
+        g_gearbox_data.spindle_on_before_shift = false;
+    }
+
+    if (!pins_cleared)
+    {
+        g_gearbox_data.next = gearshift_stop;
+        return;
     }
 
+    stats_shift_done(get_gear_index(g_gearbox_data.target_gear));
+
     /* We are done shifting, reset everything */
     g_gearbox_data.next = NULL;
     g_gearbox_data.spindle_on_before_shift = false;
+    g_gearbox_data.slow_only = false;
+}
+
+static void gearshift_sequence(long period);
+
+/* Proceed to the next shaft in the sequence, stop shifting once all
+ * shafts are done */
+static void gearshift_sequence_next(long period)
+{
+    g_gearbox_data.sequence_step++;
+
+    if (g_gearbox_data.sequence_step >= g_gearbox_data.sequence_length)
+    {
+        g_gearbox_data.next = gearshift_stop;
+        gearshift_stop(period);
+        return;
+    }
+
+    g_gearbox_data.next = gearshift_sequence;
+    gearshift_sequence(period);
 }
 
-static void gearshift_backgear(long period)
+static void gearshift_sequence(long period)
 {
-    gearshift_stage(&(g_gearbox_data.backgear), gearshift_backgear,
-                    gearshift_stop, period);
+    gearshift_stage(g_gearbox_data.sequence[g_gearbox_data.sequence_step],
+                    gearshift_sequence, gearshift_sequence_next, period);
 }
 
-static void gearshift_midrange(long period)
+/* Count reverse and lowspeed pin changes that are needed to move the shafts
+ * in the given order, starting and ending with both pins off */
+static int gearshift_sequence_toggles(shaft_data_t *sequence[], int length)
 {
-    gearshift_stage(&(g_gearbox_data.midrange), gearshift_midrange,
-                    gearshift_backgear, period);
+    bool reverse = false;
+    bool slow = false;
+    int toggles = 0;
+    int i;
+
+    for (i = 0; i < length; i++)
+    {
+        /* switching to the approach speed happens while the motor runs
+         * and does not cost us a pin interval */
+        toggles += (sequence[i]->want_reverse != reverse) +
+                   (sequence[i]->want_slow != slow);
+        reverse = sequence[i]->want_reverse;
+        slow = sequence[i]->approach_slow;
+    }
+
+    return toggles + reverse + slow;
 }
 
-static void gearshift_input_stage(long period)
+/* Let each shaft know in which state it should leave the shared reverse
+ * and lowspeed pins for its successor in the sequence */
+static void gearshift_plan_leave(void)
 {
-    gearshift_stage(&(g_gearbox_data.input_stage), gearshift_input_stage,
-                    gearshift_midrange, period);
+    int i;
+
+    for (i = 0; i < g_gearbox_data.sequence_length; i++)
+    {
+        shaft_data_t *shaft = g_gearbox_data.sequence[i];
+        if (i + 1 < g_gearbox_data.sequence_length)
+        {
+            shaft->leave_reverse = g_gearbox_data.sequence[i + 1]->want_reverse;
+            shaft->leave_slow = g_gearbox_data.sequence[i + 1]->want_slow;
+            shaft->last = false;
+        }
+        else
+        {
+            shaft->leave_reverse = false;
+            shaft->leave_slow = false;
+            shaft->last = true;
+        }
+    }
+}
+
+/* Step to the next order of the shafts in lexicographic order, returns false
+ * once all orders have been visited. */
+static bool gearshift_next_order(unsigned char *order)
+{
+    unsigned char temp;
+    int i, j;
+
+    for (i = MH400E_NUM_SHAFTS - 2; (i >= 0) && (order[i] > order[i + 1]); i--);
+    if (i < 0)
+    {
+        return false;
+    }
+
+    for (j = MH400E_NUM_SHAFTS - 1; order[j] < order[i]; j--);
+    temp = order[i];
+    order[i] = order[j];
+    order[j] = temp;
+
+    /* reverse the tail */
+    for (i++, j = MH400E_NUM_SHAFTS - 1; i < j; i++, j--)
+    {
+        temp = order[i];
+        order[i] = order[j];
+        order[j] = temp;
+    }
+    return true;
+}
+
+/* Decide in which order the shafts should be moved. Each change of the
+ * reverse or lowspeed pin costs us at least one pin interval, so we pick
+ * the order that requires the least pin changes. On a tie we stick to the
+ * default input stage -> midrange -> backgear order.
+ *
+ * If first is not NULL, this shaft is always moved first, regardless if it
+ * already reached its target or not (i.e. a shaft that is currently moving
+ * and has to finish its job). */
+static void gearshift_plan_sequence(bool neutral, shaft_data_t *first)
+{
+    /* All orders are tried in lexicographic order of the indices into
+     * shafts, which lists the shafts in the default order */
+    unsigned char order[MH400E_NUM_SHAFTS];
+    shaft_data_t *shafts[MH400E_NUM_SHAFTS];
+    shaft_data_t *candidate[MH400E_NUM_SHAFTS];
+    int best = -1;
+    int i, j, length;
+
+    for (i = 0; i < MH400E_NUM_SHAFTS; i++)
+    {
+        shaft_data_t *shaft =
+            &(g_gearbox_data.shafts[MH400E_NUM_SHAFTS - 1 - i]);
+        shafts[i] = shaft;
+        order[i] = i;
+        gearshift_plan_travel(shaft->target_mask, shaft->current_mask,
+                              &shaft->want_reverse);
+        shaft->approach_slow = MH400E_STAGE_IS_CENTER(shaft->target_mask) ||
+                               g_gearbox_data.slow_only;
+        /* A shaft that is further away starts at full speed and only
+         * slows down for the final segment */
+        shaft->target_position = gearshift_travel_position(shaft->target_mask);
+        shaft->want_slow = shaft->approach_slow &&
+                           (g_gearbox_data.slow_only ||
+                            gearshift_approaching(shaft));
+    }
+
+    g_gearbox_data.sequence_step = 0;
+    g_gearbox_data.sequence_length = 0;
+
+    do
+    {
+        length = 0;
+        for (j = 0; j < MH400E_NUM_SHAFTS; j++)
+        {
+            shaft_data_t *shaft = shafts[order[j]];
+
+            /* Shafts that are already in place do not need to be moved,
+             * for neutral we only care about the neutral shaft */
+            if ((shaft != first) &&
+                ((shaft->current_mask == shaft->target_mask) ||
+                (neutral && (shaft !=
+                    &(g_gearbox_data.shafts[MH400E_NEUTRAL_SHAFT])))))
+            {
+                continue;
+            }
+            candidate[length++] = shaft;
+        }
+
+        if ((first != NULL) && (candidate[0] != first))
+        {
+            continue;
+        }
+
+        j = gearshift_sequence_toggles(candidate, length);
+        if ((best < 0) || (j < best))
+        {
+            best = j;
+            g_gearbox_data.sequence_length = length;
+            for (j = 0; j < length; j++)
+            {
+                g_gearbox_data.sequence[j] = candidate[j];
+            }
+        }
+    } while (gearshift_next_order(order));
+
+    gearshift_plan_leave();
 }
 
 /* Call this function once per each thread cycle to handle gearshifting,
@@ -551,6 +920,7 @@ static void gearshift_input_stage(long period)
 static void gearshift_handle(long period)
 {
     twitch_handle(period);
+    stats_shift_update(period);
 
     if (g_gearbox_data.next == NULL)
     {
@@ -566,52 +936,378 @@ static void gearshift_handle(long period)
 /* Start shifting process */
 static void gearshift_start(pair_t *target_gear, long period)
 {
+    int i;
+
     if (estop_on_spindle_running())
     {
         return;
     }
 
-    g_gearbox_data.backgear.target_mask = (target_gear->value) & 0x000f;
-    g_gearbox_data.midrange.target_mask = (target_gear->value & 0x00f0) >> 4;
-    g_gearbox_data.input_stage.target_mask = 
-                                    (target_gear->value & 0x0f00) >> 8;
+    /* Parameters may be changed between shifts, but not during a shift */
+    timing_latch();
+
+    stats_shift_start(get_gear_index(get_current_gear()));
+    g_gearbox_data.target_gear = target_gear;
+    g_gearbox_data.resume_gear = NULL;
+
+    for (i = 0; i < MH400E_NUM_SHAFTS; i++)
+    {
+        g_gearbox_data.shafts[i].target_mask =
+            MH400E_SHAFT_MASK(target_gear->value, i);
+    }
+
+    *g_gearbox_data.report_crossings = 0;
+
+    /* Shifts may also be started while the spindle is already at rest
+     * (pre-positioning, prediction, recovery), keep it from being started
+     * until we are done */
+    if (!*g_gearbox_data.do_stop_spindle)
+    {
+        *g_gearbox_data.do_stop_spindle = true;
+        g_gearbox_data.release_spindle = true;
+    }
 
     /* Make sure to leave 100ms between setting start_gear_shift to "on"
      * and further operations */
-    g_gearbox_data.delay = MH400E_GENERIC_PIN_INTERVAL;
+    g_gearbox_data.delay = g_timing.generic_pin_interval;
 
     *g_gearbox_data.start_shift = true;
 
 	twitch_start(period);
 
     /* Special case: if we want to go to the neutral position, we
-     * only care about the backgear stage, so we can jump right to it */
-    if (g_gearbox_data.backgear.target_mask ==
-            mh400e_gears[MH400E_NEUTRAL_GEAR_INDEX].value) {
-        g_gearbox_data.next = gearshift_backgear;
+     * only care about the neutral shaft */
+    gearshift_plan_sequence(target_gear->value ==
+            mh400e_gears[MH400E_NEUTRAL_GEAR_INDEX].value, NULL);
+
+    if (g_gearbox_data.sequence_length > 0)
+    {
+        g_gearbox_data.next = gearshift_sequence;
+    }
+    else
+    {
+        g_gearbox_data.next = gearshift_stop;
+    }
+}
+
+/* Change the target of a gear shift that is in progress */
+static bool gearshift_retarget(pair_t *target_gear, long period)
+{
+    shaft_data_t *current = NULL;
+    unsigned char target[MH400E_NUM_SHAFTS];
+    bool neutral = (target_gear->value ==
+                    mh400e_gears[MH400E_NEUTRAL_GEAR_INDEX].value);
+    bool changed = false;
+    int i;
+
+    /* Too late, the spindle has already been released */
+    if ((g_gearbox_data.next == NULL) || !(*g_gearbox_data.start_shift))
+    {
+        return false;
+    }
+
+    /* Neutral only cares about the neutral shaft, the other shafts keep
+     * their targets so that a shaft which is currently moving can complete
+     * its move */
+    for (i = 0; i < MH400E_NUM_SHAFTS; i++)
+    {
+        target[i] = MH400E_SHAFT_MASK(target_gear->value, i);
+        if (neutral && (i != MH400E_NEUTRAL_SHAFT))
+        {
+            target[i] = g_gearbox_data.shafts[i].target_mask;
+        }
+        changed = changed || (g_gearbox_data.shafts[i].target_mask != target[i]);
+    }
+
+    g_gearbox_data.target_gear = target_gear;
+    if (!changed)
+    {
+        return true;
+    }
+
+    /* The shaft that we are working on has to complete its current job
+     * first, either by reaching its unchanged target, or by stopping and
+     * going through the restart logic which will bring the reverse and
+     * lowspeed pins into a defined state before we plan it again. */
+    if ((g_gearbox_data.next != gearshift_stop) &&
+        (g_gearbox_data.sequence_step < g_gearbox_data.sequence_length))
+    {
+        current = g_gearbox_data.sequence[g_gearbox_data.sequence_step];
+    }
+
+    for (i = 0; i < MH400E_NUM_SHAFTS; i++)
+    {
+        g_gearbox_data.shafts[i].target_mask = target[i];
+    }
+
+    if ((current != NULL) && (current->state != SHAFT_STATE_OFF))
+    {
+        current->target_position =
+            gearshift_travel_position(current->target_mask);
+
+        if ((current->state == SHAFT_STATE_ON) &&
+            (current->current_mask != current->target_mask))
+        {
+            bool reverse;
+            gearshift_plan_travel(current->target_mask, current->current_mask,
+                                  &reverse);
+            if (reverse != *current->motor_reverse)
+            {
+                if (*current->motor_on)
+                {
+                    /* De-energize the motor and wait before the restart
+                     * logic changes the direction */
+                    *current->motor_on = false;
+                    current->state = SHAFT_STATE_RESTART;
+                    g_gearbox_data.delay = g_timing.reverse_motor_interval;
+                }
+                else
+                {
+                    /* Motor did not start yet, simply plan it again */
+                    current->state = SHAFT_STATE_OFF;
+                }
+            }
+        }
     }
     else
     {
-        g_gearbox_data.next = gearshift_input_stage;
+        current = NULL;
+    }
+
+    gearshift_plan_sequence(neutral, current);
+
+    /* We might have been stopping already, keep the twitching going */
+    if (twitch_stop_completed())
+    {
+        twitch_start(period);
+    }
+
+    g_gearbox_data.next = (g_gearbox_data.sequence_length > 0) ?
+                          gearshift_sequence : gearshift_stop;
+    return true;
+}
+
+/* Estimate how far a shaft has to travel from its current to the target
+ * mask during recovery. Moving a shaft that already is at a valid position
+ * is much more expensive than moving a shaft that is in between. */
+static int gearshift_recovery_cost(shaft_data_t *shaft,
+                                   unsigned char target_mask)
+{
+    int current = gearshift_travel_position(shaft->current_mask);
+    int target = gearshift_travel_position(target_mask);
+    int distance;
+
+    if (shaft->current_mask == target_mask)
+    {
+        return 0;
+    }
+
+    /* we do not know where the shaft is, assume half way */
+    if (current < 0)
+    {
+        return 2;
+    }
+
+    distance = (target > current) ? target - current : current - target;
+
+    if ((shaft->current_mask == MH400E_STAGE_POS_LEFT) ||
+        (shaft->current_mask == MH400E_STAGE_POS_CENTER) ||
+        (shaft->current_mask == MH400E_STAGE_POS_RIGHT))
+    {
+        return distance * 10;
+    }
+
+    return distance;
+}
+
+static bool gearshift_recover(long period)
+{
+    pair_t *best = NULL;
+    int best_cost = 0;
+    int i, j;
+
+    if (get_current_gear() != NULL)
+    {
+        return false;
+    }
+
+    /* Same as with a regular shift: stop the spindle and wait */
+    if (!gearbox_spindle_stopped())
+    {
+        if (!(*g_gearbox_data.do_stop_spindle))
+        {
+            gearshift_stop_spindle();
+        }
+        return true;
+    }
+
+    /* Neutral is only considered last, so that it wins only if it is
+     * really closer than any other gear */
+    for (i = MH400E_MIN_RPM_INDEX; i <= MH400E_NUM_GEARS; i++)
+    {
+        pair_t *gear = &(mh400e_gears[(i < MH400E_NUM_GEARS) ?
+                                      i : MH400E_NEUTRAL_GEAR_INDEX]);
+        int cost = 0;
+
+        for (j = 0; j < MH400E_NUM_SHAFTS; j++)
+        {
+            if ((gear == &(mh400e_gears[MH400E_NEUTRAL_GEAR_INDEX])) &&
+                (j != MH400E_NEUTRAL_SHAFT))
+            {
+                continue;
+            }
+            cost += gearshift_recovery_cost(&(g_gearbox_data.shafts[j]),
+                                            MH400E_SHAFT_MASK(gear->value, j));
+        }
+
+        if ((best == NULL) || (cost < best_cost))
+        {
+            best = gear;
+            best_cost = cost;
+        }
+    }
+
+    rtapi_print_msg(RTAPI_MSG_INFO, "mh400e_gearbox: shafts are not in a "
+                    "known gear, moving to %u rpm\n", best->key);
+
+    /* we do not know what happened before, so go slowly */
+    g_gearbox_data.slow_only = true;
+    gearshift_start(best, period);
+    return true;
+}
+
+static bool gearshift_preposition(pair_t *gear, long period)
+{
+    unsigned neutral_bits = ((1 << MH400E_PINS_IN_GROUP) - 1) <<
+                            MH400E_SHAFT_SHIFT(MH400E_NEUTRAL_SHAFT);
+    pair_t *neutral = &(mh400e_gears[MH400E_NEUTRAL_GEAR_INDEX]);
+    unsigned value;
+    int i;
+
+    if ((gear == neutral) || (get_current_gear() != neutral) ||
+        !gearbox_spindle_stopped())
+    {
+        return false;
+    }
+
+    /* The neutral shaft stays where it is, all others go where the
+     * preselected gear wants them */
+    value = (gear->value & ~neutral_bits) | (neutral->value & neutral_bits);
+
+    for (i = 0; i < MH400E_NUM_SHAFTS; i++)
+    {
+        if (g_gearbox_data.shafts[i].current_mask !=
+            MH400E_SHAFT_MASK(value, i))
+        {
+            break;
+        }
+    }
+
+    if (i == MH400E_NUM_SHAFTS)
+    {
+        return false;
     }
+
+    /* We are still in neutral once this is done */
+    g_gearbox_data.preposition.key = neutral->key;
+    g_gearbox_data.preposition.value = value;
+    gearshift_start(&(g_gearbox_data.preposition), period);
+    return true;
 }
 
 /* Reset pins and state machine if an emergency stop was triggered. */
 static void gearbox_handle_estop(void)
 {
-    *g_gearbox_data.input_stage.motor_on = false;
-    *g_gearbox_data.midrange.motor_on = false;
-    *g_gearbox_data.backgear.motor_on = false;
+    int i;
+
+    /* Remember where we were going, shafts that already reached their
+     * target will not be moved again once we resume */
+    if (gearshift_in_progress() && *g_gearbox_data.start_shift)
+    {
+        g_gearbox_data.resume_gear = g_gearbox_data.target_gear;
+        g_gearbox_data.resume_slow_only = g_gearbox_data.slow_only;
+    }
+    stats_shift_abort();
+
+    for (i = 0; i < MH400E_NUM_SHAFTS; i++)
+    {
+        *g_gearbox_data.shafts[i].motor_on = false;
+        g_gearbox_data.shafts[i].state = SHAFT_STATE_OFF;
+        g_gearbox_data.shafts[i].run_time = 0;
+    }
     /* There are no separate pins for revers/slow for each shaft, each
      * shaft structure has pointers to the same pins, so its enough to
      * reset them only on one shaft. */
-    *g_gearbox_data.backgear.motor_reverse = false;
-    *g_gearbox_data.backgear.motor_slow = false;
+    *g_gearbox_data.shafts[0].motor_reverse = false;
+    *g_gearbox_data.shafts[0].motor_slow = false;
+    g_gearbox_data.slow_only = false;
+    g_gearbox_data.pin_delay = 0;
+    g_gearbox_data.delay = 0;
+
+    /* The spindle must not come back on its own after an emergency stop */
+    g_gearbox_data.spindle_on_before_shift = false;
+    g_gearbox_data.release_spindle = false;
 
     gearshift_stop(0); /* Will stop and reset twitching as well */
+    g_gearbox_data.next = NULL;
+    g_gearbox_data.sequence_length = 0;
+    g_gearbox_data.sequence_step = 0;
+}
+
+static void gearshift_resume_to(pair_t *target_gear)
+{
+    g_gearbox_data.resume_gear = target_gear;
+    g_gearbox_data.resume_slow_only = true;
+}
+
+static bool gearshift_resume(long period)
+{
+    pair_t *target = g_gearbox_data.resume_gear;
+    int i, remaining = 0;
+
+    if (target == NULL)
+    {
+        return false;
+    }
+
+    /* Same as with a regular shift: stop the spindle and wait. After the
+     * component has been reloaded the stop pin may not be set even if the
+     * spindle is already at rest, gearshift_start() takes care of that. */
+    if (!gearbox_spindle_stopped())
+    {
+        if (!(*g_gearbox_data.do_stop_spindle))
+        {
+            gearshift_stop_spindle();
+        }
+        return true;
+    }
+
+    /* The masks have been read again after the emergency stop has been
+     * released, only the shafts that are not in place will be moved */
+    for (i = 0; i < MH400E_NUM_SHAFTS; i++)
+    {
+        if (g_gearbox_data.shafts[i].current_mask !=
+            MH400E_SHAFT_MASK(target->value, i))
+        {
+            remaining++;
+        }
+    }
+
+    rtapi_print_msg(RTAPI_MSG_INFO, "mh400e_gearbox: resuming shift to "
+                    "%u rpm, %d shafts not in place\n", target->key,
+                    remaining);
+
+    g_gearbox_data.slow_only = g_gearbox_data.resume_slow_only;
+    gearshift_start(target, period);
+    return true;
 }
 
 static bool gearshift_in_progress(void)
 {
     return g_gearbox_data.next != NULL;
 }
+
+static bool gearbox_spindle_stopped(void)
+{
+    return *g_gearbox_data.is_spindle_stopped || standstill_detected();
+}
@@ -24,6 +24,10 @@ Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
 #define __MH400E_GEARS_H__
 
 #include "mh400e_common.h"
+#include "mh400e_io.h"
+#include "mh400e_standstill.h"
+#include "mh400e_stats.h"
+#include "mh400e_timing.h"
 
 /* One time setup function to prepare data structures related to gearbox 
  * switching*/
@@ -36,14 +40,42 @@ static void update_current_pingroup_masks(void);
 /* Combine masks from each pin group to a value representing the current
  * gear setting. A return of NULL means that a corresponding value could
  * not be found, which may indicate a gearshift being in progress- */
-static pair_t* get_current_gear(tree_node_t *tree);
+static pair_t* get_current_gear(void);
+
+/* Index of a gear in the gears table, -1 for NULL and for the gear used
+ * by pre-positioning, which is not in the table. */
+static int get_gear_index(pair_t *gear);
 
 /* Start gear shifting, parameter specifies the target gear that we want
  * to shift to.
  * ATTENTION: this function will set the vlaue of the start_gear_shift pin 
- * and also start twitching. */
+ * and also start twitching. The stop_spindle pin is set for the whole
+ * shift if it was not set yet, gearshift_stop() releases it again. */
 static void gearshift_start(pair_t *target_gear, long period);
 
+/* Change the target gear of a gear shift that is already in progress.
+ * Shafts that still have to move are planned again towards the new target,
+ * twitching continues and the spindle stays stopped in between. Returns
+ * false if the shift is already too far to be retargeted (i.e. the spindle
+ * has been released), in this case a new shift has to be started once
+ * the current one has been completed. */
+static bool gearshift_retarget(pair_t *target_gear, long period);
+
+/* Check if the shafts are in a known gear, if not start a shift towards
+ * the gear that can be reached with the least shaft travel. Shafts that
+ * are already in a valid position are only moved if there is no other way,
+ * all shafts are moved at low speed. Returns true while the recovery is
+ * waiting for the spindle to stop or if the shift has been started, false
+ * if the shafts are in a known gear. */
+static bool gearshift_recover(long period);
+
+/* While the gearbox is in neutral and the spindle is stopped, move all
+ * shafts except the neutral shaft to their positions in the given gear, so
+ * that only the neutral shaft is left to move once this gear is actually
+ * requested. Returns true if a shift has been started, false if there is
+ * nothing to do. */
+static bool gearshift_preposition(pair_t *gear, long period);
+
 /* Call this function once per each thread cycle to handle gearshifting,
  * implies that gearshift_start() has been called in order to set the
  * target gear.
@@ -51,12 +83,30 @@ static void gearshift_start(pair_t *target_gear, long period);
  * Incorporates the twitching handler. */
 static void gearshift_handle(long period);
 
-/* Reset pins and state machine if an emergency stop was triggered. */
+/* Reset pins and state machine if an emergency stop was triggered. If a
+ * shift was in progress, its target gear is kept for gearshift_resume(). */
 static void gearbox_handle_estop(void);
 
+/* Continue a shift that has been interrupted by an emergency stop towards
+ * its original target gear, only shafts that are not in place according
+ * to the current sensor masks are moved. Returns true while waiting for the
+ * spindle to stop or if the shift has been started, false if there is
+ * nothing to resume. */
+static bool gearshift_resume(long period);
+
+/* Let gearshift_resume() continue a shift towards the given gear that was
+ * in progress before the component was reloaded. We do not know what
+ * happened in between, so all shafts are moved at low speed. */
+static void gearshift_resume_to(pair_t *target_gear);
+
 /* Returns true if a gear shifting operation is currently in progress */
 static bool gearshift_in_progress(void);
 
+/* Returns the state of the spindle stopped input, regardless if it comes
+ * from the discrete pin or the packed interface, or if the spindle encoder
+ * already detected that the spindle came to rest */
+static bool gearbox_spindle_stopped(void);
+
 /* really ugly way of keeping more order and splitting the sources,
  * halcompile does not allow to link multipe source files together, so
  * ultimately all sources need to be included by the .comp directly */
@@ -0,0 +1,220 @@
+/*
+LinuxCNC component for controlling the MAHO MH400E gearbox.
+
+Copyright (C) 2018 Sergey 'Jin' Bostandzhyan <jin@mediatomb.cc>
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+as published by the Free Software Foundation; either version 2
+of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+*/
+
+/* Implementation of the sensor health statistics. */
+
+#include "mh400e_health.h"
+
+/* Statistics of one shaft and its sensors */
+typedef struct
+{
+    unsigned char last_mask;    /* mask seen in the previous cycle */
+    bool was_on;                /* motor state in the previous cycle */
+    bool was_invalid;           /* previous mask could not be decoded */
+    long long off_since;        /* time in ns the motor was switched off */
+    long long started;          /* time in ns the motor was switched on */
+    int start_position;         /* travel position when the motor started */
+    bool start_slow;            /* lowspeed pin when the motor started */
+    /* time in ns of the last edge of each sensor */
+    long long edge[MH400E_PINS_IN_GROUP];
+    /* rolling time per sensor segment in ns, indexed by target (0: end
+     * position, 1: center, which is approached at low speed) */
+    double baseline[2];
+    unsigned baseline_moves[2];
+    double penalty;             /* decaying sum of health events */
+    hal_u32_t *count_invalid;
+    hal_u32_t *count_idle_edges[MH400E_PINS_IN_GROUP];
+    hal_u32_t *count_bounces[MH400E_PINS_IN_GROUP];
+    hal_float_t *drift;
+    hal_float_t *score;
+} health_shaft_t;
+
+/* group sensor health related data */
+static struct
+{
+    long long now;              /* time in ns since the first update */
+    bool primed;                /* masks have been seen at least once */
+    health_shaft_t shafts[MH400E_NUM_SHAFTS];
+} g_health_data;
+
+FUNCTION(health_setup)
+{
+    health_shaft_t *h;
+    int i, j;
+
+    g_health_data.now = 0;
+    g_health_data.primed = false;
+
+    for (i = 0; i < MH400E_NUM_SHAFTS; i++)
+    {
+        h = &(g_health_data.shafts[i]);
+        h->last_mask = 0;
+        h->was_on = false;
+        h->was_invalid = false;
+        /* the motors are off on startup and have been for a while */
+        h->off_since = -MH400E_HEALTH_SETTLE_TIME;
+        h->started = 0;
+        h->start_position = -1;
+        h->start_slow = false;
+        for (j = 0; j < MH400E_PINS_IN_GROUP; j++)
+        {
+            h->edge[j] = -MH400E_HEALTH_BOUNCE_TIME;
+            h->count_idle_edges[j] =
+                &sensor_idle_edges(i * MH400E_PINS_IN_GROUP + j);
+            h->count_bounces[j] =
+                &sensor_bounces(i * MH400E_PINS_IN_GROUP + j);
+        }
+        for (j = 0; j < 2; j++)
+        {
+            h->baseline[j] = 0;
+            h->baseline_moves[j] = 0;
+        }
+        h->penalty = 0;
+        h->count_invalid = &sensor_invalid(i);
+        h->drift = &shaft_drift(i);
+        h->score = &sensor_health(i);
+        *h->drift = 1.0;
+        *h->score = 1.0;
+    }
+}
+
+/* Compare the time per segment of a move that reached its target against
+ * the baseline and update the baseline */
+static void health_move_done(health_shaft_t *h, shaft_data_t *shaft)
+{
+    int end = gearshift_travel_position(shaft->current_mask);
+    int target = MH400E_STAGE_IS_CENTER(shaft->target_mask);
+    double per_segment;
+    int distance;
+
+    /* Low speed recovery moves, calibration runs and moves that switched
+     * to low speed for the final segment would spoil the baseline. The
+     * lowspeed pin is not touched before the motor is off. */
+    if ((shaft->current_mask != shaft->target_mask) ||
+        (h->start_position < 0) || (end < 0) || g_gearbox_data.slow_only ||
+        calibrate_in_progress() || (*shaft->motor_slow != h->start_slow))
+    {
+        return;
+    }
+
+    distance = (end > h->start_position) ? end - h->start_position :
+                                           h->start_position - end;
+    if (distance == 0)
+    {
+        return;
+    }
+
+    per_segment = (double)(g_health_data.now - h->started) / distance;
+
+    if (h->baseline_moves[target] > 0)
+    {
+        *h->drift = per_segment / h->baseline[target];
+        if (*h->drift > MH400E_HEALTH_DRIFT_LIMIT)
+        {
+            h->penalty += 1.0;
+        }
+    }
+
+    /* plain average until we have enough moves, rolling average after */
+    if (h->baseline_moves[target] < MH400E_HEALTH_BASELINE_MOVES)
+    {
+        h->baseline_moves[target]++;
+    }
+    h->baseline[target] += (per_segment - h->baseline[target]) /
+                           h->baseline_moves[target];
+}
+
+static void health_update(long period)
+{
+    health_shaft_t *h;
+    shaft_data_t *shaft;
+    unsigned char changed;
+    bool on, idle, invalid;
+    int i, j;
+
+    g_health_data.now += period;
+
+    for (i = 0; i < MH400E_NUM_SHAFTS; i++)
+    {
+        h = &(g_health_data.shafts[i]);
+        shaft = &(g_gearbox_data.shafts[i]);
+        on = *shaft->motor_on;
+
+        if (!g_health_data.primed)
+        {
+            h->last_mask = shaft->current_mask;
+        }
+
+        h->penalty -= h->penalty * period / MH400E_HEALTH_DECAY_TIME;
+
+        if (on && !h->was_on)
+        {
+            h->started = g_health_data.now;
+            h->start_position = gearshift_travel_position(shaft->current_mask);
+            h->start_slow = *shaft->motor_slow;
+        }
+        else if (!on && h->was_on)
+        {
+            h->off_since = g_health_data.now;
+            health_move_done(h, shaft);
+        }
+        h->was_on = on;
+
+        /* the shaft may still coast for a bit after the motor is off */
+        idle = !on &&
+            (g_health_data.now - h->off_since > MH400E_HEALTH_SETTLE_TIME);
+
+        changed = shaft->current_mask ^ h->last_mask;
+        for (j = 0; changed != 0; j++, changed >>= 1)
+        {
+            if (!(changed & 1))
+            {
+                continue;
+            }
+
+            if (g_health_data.now - h->edge[j] < MH400E_HEALTH_BOUNCE_TIME)
+            {
+                (*h->count_bounces[j])++;
+                h->penalty += 1.0;
+            }
+            h->edge[j] = g_health_data.now;
+
+            if (idle)
+            {
+                (*h->count_idle_edges[j])++;
+                h->penalty += 1.0;
+            }
+        }
+        h->last_mask = shaft->current_mask;
+
+        /* count each occurence once, not each cycle */
+        invalid = (gearshift_travel_position(shaft->current_mask) < 0);
+        if (invalid && !h->was_invalid && idle)
+        {
+            (*h->count_invalid)++;
+            h->penalty += 1.0;
+        }
+        h->was_invalid = invalid;
+
+        *h->score = 1.0 / (1.0 + h->penalty);
+    }
+
+    g_health_data.primed = true;
+}
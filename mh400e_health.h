@@ -0,0 +1,50 @@
+/*
+LinuxCNC component for controlling the MAHO MH400E gearbox.
+
+Copyright (C) 2018 Sergey 'Jin' Bostandzhyan <jin@mediatomb.cc>
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+as published by the Free Software Foundation; either version 2
+of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+*/
+
+/* Sensor health statistics: degrading position switches show up as
+ * bouncing, spurious edges and slower shifts long before they fail, keep
+ * track of these per shaft and per sensor. */
+
+#ifndef __MH400E_HEALTH_H__
+#define __MH400E_HEALTH_H__
+
+#include <rtapi.h>
+
+#include "mh400e_common.h"
+#include "mh400e_gears.h"
+#include "mh400e_calibrate.h"
+
+/* Call only once after gearbox_setup(), sets up the global sensor health
+ * data structure */
+FUNCTION(health_setup);
+
+/* Call this function once per thread cycle after the shaft masks have been
+ * updated. It counts invalid sensor combinations and sensor edges while the
+ * shaft motor is off, bounces of each sensor and compares the time per
+ * sensor segment of each completed move against a rolling baseline. The
+ * work per cycle does not depend on the history. */
+static void health_update(long period);
+
+/* really ugly way of keeping more order and splitting the sources,
+ * halcompile does not allow to link multipe source files together, so
+ * ultimately all sources need to be included by the .comp directly */
+#include "mh400e_health.c"
+
+#endif//__MH400E_HEALTH_H__
@@ -0,0 +1,210 @@
+/*
+LinuxCNC component for controlling the MAHO MH400E gearbox.
+
+Copyright (C) 2018 Sergey 'Jin' Bostandzhyan <jin@mediatomb.cc>
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+as published by the Free Software Foundation; either version 2
+of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+*/
+
+/* Access to the MESA 7i84 inputs and outputs. */
+
+#include "mh400e_io.h"
+
+/* group interface data */
+static struct
+{
+    bool packed;            /* true if the packed interface is used */
+    bool setup_done;
+    unsigned sensors;       /* input snapshot of this cycle */
+    hal_bit_t outputs[MH400E_NUM_BUFFERED_OUTPUTS]; /* bits to commit */
+    hal_bit_t stopped;      /* spindle stopped input of this cycle */
+    hal_u32_t *sensors_pin;
+    hal_u32_t *controls_pin;
+    /* discrete pins */
+    hal_bit_t *sensor_pins[MH400E_NUM_SENSORS];
+    hal_bit_t *stopped_pin;
+    hal_bit_t *output_pins[MH400E_NUM_BUFFERED_OUTPUTS];
+} g_io_data;
+
+/* Call only once before any other setup function, decides which interface
+ * mode is used */
+FUNCTION(io_setup)
+{
+    int i;
+
+    for (i = 0; i < MH400E_NUM_BUFFERED_OUTPUTS; i++)
+    {
+        g_io_data.outputs[i] = false;
+        g_io_data.output_pins[i] = NULL;
+    }
+
+    g_io_data.packed = packed_io;
+    g_io_data.sensors = 0;
+    g_io_data.stopped = false;
+
+    /* Grabbing the pin pointers in EXTRA_SETUP did not work because the
+     * component did not seem to be fully initializedt there.
+     *
+     * Another issue:
+     * while output pins are defined as (*__comp_inst->pin_name) by
+     * halcompile, input pins are turned into (0+*__comp_inst->pin_name)
+     * which makes it impossible to get the pointers via the defines
+     * created by halcompile. Accessing the pin variable directly did not
+     * work due to macro expansion, only workaround I found was to temporarily
+     * disable the macros.
+     */
+    #pragma push_macro("sensors_in")
+    #undef sensors_in
+    g_io_data.sensors_pin = __comp_inst->sensors_in;
+    #pragma pop_macro("sensors_in")
+    g_io_data.controls_pin = &controls_out;
+
+    /* the sensor pins in the order of the MESA 7i84 inputs */
+    #pragma push_macro("reducer_left")
+    #pragma push_macro("reducer_right")
+    #pragma push_macro("reducer_center")
+    #pragma push_macro("reducer_left_center")
+    #pragma push_macro("middle_left")
+    #pragma push_macro("middle_right")
+    #pragma push_macro("middle_center")
+    #pragma push_macro("middle_left_center")
+    #pragma push_macro("input_left")
+    #pragma push_macro("input_right")
+    #pragma push_macro("input_center")
+    #pragma push_macro("input_left_center")
+    #pragma push_macro("spindle_stopped")
+    #undef reducer_left
+    #undef reducer_right
+    #undef reducer_center
+    #undef reducer_left_center
+    #undef middle_left
+    #undef middle_right
+    #undef middle_center
+    #undef middle_left_center
+    #undef input_left
+    #undef input_right
+    #undef input_center
+    #undef input_left_center
+    #undef spindle_stopped
+    g_io_data.sensor_pins[0] = __comp_inst->reducer_left;
+    g_io_data.sensor_pins[1] = __comp_inst->reducer_right;
+    g_io_data.sensor_pins[2] = __comp_inst->reducer_center;
+    g_io_data.sensor_pins[3] = __comp_inst->reducer_left_center;
+    g_io_data.sensor_pins[4] = __comp_inst->middle_left;
+    g_io_data.sensor_pins[5] = __comp_inst->middle_right;
+    g_io_data.sensor_pins[6] = __comp_inst->middle_center;
+    g_io_data.sensor_pins[7] = __comp_inst->middle_left_center;
+    g_io_data.sensor_pins[8] = __comp_inst->input_left;
+    g_io_data.sensor_pins[9] = __comp_inst->input_right;
+    g_io_data.sensor_pins[10] = __comp_inst->input_center;
+    g_io_data.sensor_pins[11] = __comp_inst->input_left_center;
+    g_io_data.stopped_pin = __comp_inst->spindle_stopped;
+    #pragma pop_macro("reducer_left")
+    #pragma pop_macro("reducer_right")
+    #pragma pop_macro("reducer_center")
+    #pragma pop_macro("reducer_left_center")
+    #pragma pop_macro("middle_left")
+    #pragma pop_macro("middle_right")
+    #pragma pop_macro("middle_center")
+    #pragma pop_macro("middle_left_center")
+    #pragma pop_macro("input_left")
+    #pragma pop_macro("input_right")
+    #pragma pop_macro("input_center")
+    #pragma pop_macro("input_left_center")
+    #pragma pop_macro("spindle_stopped")
+
+    g_io_data.setup_done = true;
+}
+
+static hal_bit_t *io_output(int index, hal_bit_t *pin)
+{
+    g_io_data.output_pins[index] = pin;
+    g_io_data.outputs[index] = *pin;
+    return &(g_io_data.outputs[index]);
+}
+
+static unsigned io_read(void)
+{
+    unsigned word = 0;
+    int i;
+
+    if (g_io_data.packed)
+    {
+        word = *g_io_data.sensors_pin;
+    }
+    else
+    {
+        for (i = 0; i < MH400E_NUM_SENSORS; i++)
+        {
+            word |= (*g_io_data.sensor_pins[i] ? 1 : 0) << i;
+        }
+        word |= (*g_io_data.stopped_pin ? 1 : 0) <<
+                MH400E_INPUT_SPINDLE_STOPPED;
+    }
+
+    g_io_data.sensors = word;
+    g_io_data.stopped = (word >> MH400E_INPUT_SPINDLE_STOPPED) & 1;
+    return word;
+}
+
+static unsigned char io_sensor_group(int input)
+{
+    return (g_io_data.sensors >> input) & ((1 << MH400E_PINS_IN_GROUP) - 1);
+}
+
+static hal_bit_t *io_spindle_stopped(void)
+{
+    return &(g_io_data.stopped);
+}
+
+static void io_commit(void)
+{
+    unsigned word = 0;
+    int i;
+
+    /* nothing to commit before the first setup */
+    if (!g_io_data.setup_done)
+    {
+        return;
+    }
+
+    /* not part of the packed word */
+    for (i = MH400E_NUM_OUTPUTS; i < MH400E_NUM_BUFFERED_OUTPUTS; i++)
+    {
+        if (g_io_data.output_pins[i] != NULL)
+        {
+            *g_io_data.output_pins[i] = g_io_data.outputs[i];
+        }
+    }
+
+    if (!g_io_data.packed)
+    {
+        for (i = 0; i < MH400E_NUM_OUTPUTS; i++)
+        {
+            if (g_io_data.output_pins[i] != NULL)
+            {
+                *g_io_data.output_pins[i] = g_io_data.outputs[i];
+            }
+        }
+        return;
+    }
+
+    for (i = 0; i < MH400E_NUM_OUTPUTS; i++)
+    {
+        word |= g_io_data.outputs[i] << i;
+    }
+
+    *g_io_data.controls_pin = word;
+}
@@ -0,0 +1,69 @@
+/*
+LinuxCNC component for controlling the MAHO MH400E gearbox.
+
+Copyright (C) 2018 Sergey 'Jin' Bostandzhyan <jin@mediatomb.cc>
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+as published by the Free Software Foundation; either version 2
+of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+*/
+
+/* Access to the MESA 7i84 inputs and outputs, either via the discrete
+ * pins or via one packed input and one packed output word.
+ *
+ * In both modes all inputs are read into one snapshot at the beginning of
+ * each cycle and all outputs are buffered and written at the end of it, so
+ * that the state machines base their decisions on consistent inputs and
+ * touch the HAL shared memory only twice per cycle. The stop_spindle,
+ * spindle_at_speed and estop_out pins of the component are not 7i84
+ * signals, but are buffered and committed the same way. */
+
+#ifndef __MH400E_IO_H__
+#define __MH400E_IO_H__
+
+#include <rtapi.h>
+
+#include "mh400e_common.h"
+
+/* Call only once before any other setup function, decides which interface
+ * mode is used */
+FUNCTION(io_setup);
+
+/* Returns the pointer that the state machines should use to access the
+ * given output: the buffered output bit that is committed to the discrete
+ * pin or, for the 7i84 outputs, to the packed output word. */
+static hal_bit_t *io_output(int index, hal_bit_t *pin);
+
+/* Take the snapshot of all 7i84 inputs, call this function once at the
+ * beginning of each thread cycle. Returns the inputs in the layout of the
+ * packed input word regardless of the interface mode. */
+static unsigned io_read(void);
+
+/* Returns the bit mask of the pin group that starts at the given input,
+ * as of the last io_read() */
+static unsigned char io_sensor_group(int input);
+
+/* Returns the spindle stopped input as of the last io_read() */
+static hal_bit_t *io_spindle_stopped(void);
+
+/* Commit all outputs to the discrete pins or to the packed output word
+ * with a single store, call this function once at the end of each thread
+ * cycle. */
+static void io_commit(void);
+
+/* really ugly way of keeping more order and splitting the sources,
+ * halcompile does not allow to link multipe source files together, so
+ * ultimately all sources need to be included by the .comp directly */
+#include "mh400e_io.c"
+
+#endif//__MH400E_IO_H__
@@ -0,0 +1,164 @@
+/*
+LinuxCNC component for controlling the MAHO MH400E gearbox.
+
+Copyright (C) 2018 Sergey 'Jin' Bostandzhyan <jin@mediatomb.cc>
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+as published by the Free Software Foundation; either version 2
+of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+*/
+
+/* Implementation of the predictive gear pre-positioning. */
+
+#include "mh400e_predict.h"
+
+/* group prediction related data */
+static struct
+{
+    /* ring buffer with the gear indices of the most recent requests */
+    unsigned char history[MH400E_PREDICT_WINDOW];
+    unsigned head;      /* next ring buffer position to write to */
+    unsigned count;     /* number of valid entries in the ring buffer */
+    /* number of occurences of each gear within the ring buffer */
+    unsigned histogram[MH400E_NUM_GEARS];
+    unsigned last_key;  /* rpm of the last recorded request */
+    long long idle;     /* time in ns we have been idle so far */
+    pair_t *positioned; /* gear we pre-positioned to, NULL if none */
+    hal_u32_t *hits;    /* pointer to the predict_hits pin */
+} g_predict_data;
+
+/* Call only once, sets up the global prediction data structure */
+FUNCTION(predict_setup)
+{
+    int i;
+
+    for (i = 0; i < MH400E_NUM_GEARS; i++)
+    {
+        g_predict_data.histogram[i] = 0;
+    }
+
+    g_predict_data.head = 0;
+    g_predict_data.count = 0;
+    g_predict_data.last_key = mh400e_gears[MH400E_NEUTRAL_GEAR_INDEX].key;
+    g_predict_data.idle = 0;
+    g_predict_data.positioned = NULL;
+    g_predict_data.hits = &predict_hits;
+}
+
+/* Return the most frequently requested gear within our window, ties are
+ * resolved in favor of the most recent request. */
+static pair_t *predict_most_likely(void)
+{
+    unsigned i;
+    unsigned best_count = 0;
+    int best = -1;
+
+    /* walk the ring buffer from the newest to the oldest entry */
+    for (i = 1; i <= g_predict_data.count; i++)
+    {
+        unsigned index = g_predict_data.history[
+            (g_predict_data.head + MH400E_PREDICT_WINDOW - i) %
+                MH400E_PREDICT_WINDOW];
+
+        if (g_predict_data.histogram[index] > best_count)
+        {
+            best_count = g_predict_data.histogram[index];
+            best = index;
+        }
+    }
+
+    if (best < 0)
+    {
+        return NULL;
+    }
+
+    return &(mh400e_gears[best]);
+}
+
+static void predict_request(pair_t *requested)
+{
+    unsigned char index;
+
+    /* we get called each cycle while a request is pending, only record
+     * actual changes */
+    if (requested->key == g_predict_data.last_key)
+    {
+        return;
+    }
+
+    g_predict_data.last_key = requested->key;
+    g_predict_data.idle = 0;
+
+    /* neutral is what we get between jobs, it is not a prediction target */
+    if (requested->key == mh400e_gears[MH400E_NEUTRAL_GEAR_INDEX].key)
+    {
+        return;
+    }
+
+    if (g_predict_data.positioned == requested)
+    {
+        (*g_predict_data.hits)++;
+    }
+    g_predict_data.positioned = NULL;
+
+    /* drop the oldest entry if the window is full */
+    if (g_predict_data.count == MH400E_PREDICT_WINDOW)
+    {
+        g_predict_data.histogram[
+            g_predict_data.history[g_predict_data.head]]--;
+    }
+    else
+    {
+        g_predict_data.count++;
+    }
+
+    index = (unsigned char)(requested - mh400e_gears);
+    g_predict_data.history[g_predict_data.head] = index;
+    g_predict_data.histogram[index]++;
+    g_predict_data.head = (g_predict_data.head + 1) % MH400E_PREDICT_WINDOW;
+}
+
+static pair_t *predict_idle(pair_t *current, bool idle, long long idle_time,
+                            long period)
+{
+    pair_t *predicted;
+
+    /* Only predict once per idle phase */
+    if (!idle || (g_predict_data.positioned != NULL))
+    {
+        g_predict_data.idle = 0;
+        return NULL;
+    }
+
+    if (g_predict_data.idle < idle_time)
+    {
+        g_predict_data.idle = g_predict_data.idle + period;
+        return NULL;
+    }
+
+    predicted = predict_most_likely();
+    if (predicted == NULL)
+    {
+        return NULL;
+    }
+
+    g_predict_data.positioned = predicted;
+
+    /* Gearbox might already be where we want it to be */
+    if (predicted == current)
+    {
+        return NULL;
+    }
+
+    return predicted;
+}
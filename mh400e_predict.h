@@ -0,0 +1,53 @@
+/*
+LinuxCNC component for controlling the MAHO MH400E gearbox.
+
+Copyright (C) 2018 Sergey 'Jin' Bostandzhyan <jin@mediatomb.cc>
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+as published by the Free Software Foundation; either version 2
+of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+*/
+
+/* Predictive gear pre-positioning: while the machine is idle between jobs,
+ * move the gearbox to the gear that is most likely to be requested next. */
+
+#ifndef __MH400E_PREDICT_H__
+#define __MH400E_PREDICT_H__
+
+#include <rtapi.h>
+
+#include "mh400e_common.h"
+
+/* Call only once, sets up the global prediction data structure */
+FUNCTION(predict_setup);
+
+/* Call this function with each newly quantized speed request, it will
+ * record the request in the sliding window histogram and count the hit if
+ * we correctly pre-positioned the gearbox for it. */
+static void predict_request(pair_t *requested);
+
+/* Call this function once per thread cycle while no gear shift is in
+ * progress. The idle parameter tells if the spindle is stopped and no
+ * speed is requested, idle_time specifies how long (in nanoseconds) this
+ * condition has to last before we pre-position the gearbox.
+ *
+ * Returns the gear we should shift to or NULL if nothing needs to be done. */
+static pair_t *predict_idle(pair_t *current, bool idle, long long idle_time,
+                            long period);
+
+/* really ugly way of keeping more order and splitting the sources,
+ * halcompile does not allow to link multipe source files together, so
+ * ultimately all sources need to be included by the .comp directly */
+#include "mh400e_predict.c"
+
+#endif//__MH400E_PREDICT_H__
@@ -0,0 +1,141 @@
+/*
+LinuxCNC component for controlling the MAHO MH400E gearbox.
+
+Copyright (C) 2018 Sergey 'Jin' Bostandzhyan <jin@mediatomb.cc>
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+as published by the Free Software Foundation; either version 2
+of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+*/
+
+/* Implementation of the warm restart snapshot. */
+
+#include "mh400e_snapshot.h"
+
+/* group snapshot related data, pointers to the snapshot output pins */
+static struct
+{
+    hal_s32_t *gear;
+    hal_s32_t *target;
+    hal_u32_t *masks;
+    hal_float_t *request;
+} g_snapshot_data;
+
+FUNCTION(snapshot_setup)
+{
+    snapshot_version = MH400E_SNAPSHOT_VERSION;
+
+    g_snapshot_data.gear = &snapshot_gear;
+    g_snapshot_data.target = &snapshot_target;
+    g_snapshot_data.masks = &snapshot_masks;
+    g_snapshot_data.request = &snapshot_request;
+
+    *g_snapshot_data.gear = -1;
+    *g_snapshot_data.target = -1;
+}
+
+/* Sensor masks of all shafts in one value, laid out like the gear values */
+static unsigned snapshot_current_masks(void)
+{
+    unsigned combined = 0;
+    int i;
+
+    for (i = 0; i < MH400E_NUM_SHAFTS; i++)
+    {
+        combined |= g_gearbox_data.shafts[i].current_mask <<
+                    MH400E_SHAFT_SHIFT(i);
+    }
+    return combined;
+}
+
+static void snapshot_update(float request)
+{
+    pair_t *current;
+
+    *g_snapshot_data.request = request;
+
+    if (gearshift_in_progress())
+    {
+        *g_snapshot_data.target =
+            get_gear_index(g_gearbox_data.target_gear);
+        return;
+    }
+
+    *g_snapshot_data.target = -1;
+
+    /* only a gear we are not shifting away from is confirmed */
+    current = get_current_gear();
+    if (current == NULL)
+    {
+        return;
+    }
+
+    *g_snapshot_data.gear = get_gear_index(current);
+    *g_snapshot_data.masks = snapshot_current_masks();
+}
+
+static bool snapshot_restore(unsigned version, int gear, int target,
+                             unsigned masks, float saved_request,
+                             float *request)
+{
+    pair_t *current = get_current_gear();
+
+    /* no snapshot given */
+    if (version == 0)
+    {
+        return false;
+    }
+
+    if ((version != MH400E_SNAPSHOT_VERSION) ||
+        (gear < -1) || (gear >= MH400E_NUM_GEARS) ||
+        (target < -1) || (target >= MH400E_NUM_GEARS))
+    {
+        rtapi_print_msg(RTAPI_MSG_ERR, "mh400e_gearbox: ignoring invalid "
+                        "state snapshot (version %u)\n", version);
+        return false;
+    }
+
+    if (target >= 0)
+    {
+        /* the shift was completed after the snapshot was taken */
+        if (current == &(mh400e_gears[target]))
+        {
+            rtapi_print_msg(RTAPI_MSG_INFO, "mh400e_gearbox: warm restart "
+                            "in %u rpm\n", current->key);
+            *request = saved_request;
+            return true;
+        }
+
+        /* the shift was interrupted, the shafts may be in transit or in
+         * some gear on the way, head for the original target instead of
+         * the nearest gear */
+        rtapi_print_msg(RTAPI_MSG_INFO, "mh400e_gearbox: warm restart, "
+                        "continuing shift to %u rpm\n",
+                        mh400e_gears[target].key);
+        gearshift_resume_to(&(mh400e_gears[target]));
+        *request = saved_request;
+        return true;
+    }
+    else if ((gear >= 0) && (current == &(mh400e_gears[gear])) &&
+             (masks == snapshot_current_masks()))
+    {
+        rtapi_print_msg(RTAPI_MSG_INFO, "mh400e_gearbox: warm restart in "
+                        "%u rpm\n", current->key);
+        *request = saved_request;
+        return true;
+    }
+
+    rtapi_print_msg(RTAPI_MSG_INFO, "mh400e_gearbox: state snapshot does "
+                    "not match the sensors, ignoring it\n");
+    return false;
+}
@@ -0,0 +1,56 @@
+/*
+LinuxCNC component for controlling the MAHO MH400E gearbox.
+
+Copyright (C) 2018 Sergey 'Jin' Bostandzhyan <jin@mediatomb.cc>
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+as published by the Free Software Foundation; either version 2
+of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+*/
+
+/* Warm restart snapshot: the state that is needed to pick up where we left
+ * off after the component has been reloaded is shown on output pins, a
+ * userspace tool saves it as restore parameters (see
+ * tools/mh400e_snapshot.py) which are checked against the sensors on the
+ * first cycle after loading. */
+
+#ifndef __MH400E_SNAPSHOT_H__
+#define __MH400E_SNAPSHOT_H__
+
+#include <rtapi.h>
+
+#include "mh400e_common.h"
+#include "mh400e_gears.h"
+
+/* Call only once, sets up the global snapshot data structure */
+FUNCTION(snapshot_setup);
+
+/* Call this function once per thread cycle after the gearbox has been
+ * handled, request is the last speed request the gearbox acted upon */
+static void snapshot_update(float request);
+
+/* Call once on the first cycle after the sensors have been read, the
+ * arguments are the restore parameters. If a shift was in progress and
+ * the shafts did not reach its target gear, the shift is handed over to
+ * gearshift_resume(). Returns true if the snapshot was taken over, in that
+ * case request is set to the last speed request from the snapshot. */
+static bool snapshot_restore(unsigned version, int gear, int target,
+                             unsigned masks, float saved_request,
+                             float *request);
+
+/* really ugly way of keeping more order and splitting the sources,
+ * halcompile does not allow to link multipe source files together, so
+ * ultimately all sources need to be included by the .comp directly */
+#include "mh400e_snapshot.c"
+
+#endif//__MH400E_SNAPSHOT_H__
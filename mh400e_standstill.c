@@ -0,0 +1,144 @@
+/*
+LinuxCNC component for controlling the MAHO MH400E gearbox.
+
+Copyright (C) 2018 Sergey 'Jin' Bostandzhyan <jin@mediatomb.cc>
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+as published by the Free Software Foundation; either version 2
+of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+*/
+
+/* Implementation of the spindle standstill detection. */
+
+#include "mh400e_standstill.h"
+
+/* group standstill detection related data */
+static struct
+{
+    double velocity;    /* low pass filtered absolute encoder velocity */
+    long rest;          /* time in ns the filtered velocity stayed below the
+                           threshold, stops counting at the hold time */
+    bool moved;         /* encoder showed motion since the spindle_stopped
+                           input was last active */
+    bool detected;      /* bridges the time until spindle_stopped becomes
+                           active, see standstill_update() */
+    bool twitched;      /* the encoder motion comes from our own twitching
+                           until the filtered velocity shows rest again */
+    bool warned;        /* only complain once per spindle stop */
+    hal_bit_t *is_spindle_stopped;
+    hal_bit_t *stop_requested;
+} g_standstill_data;
+
+/* Call only once, sets up the global standstill detection data */
+FUNCTION(standstill_setup)
+{
+    g_standstill_data.velocity = 0;
+    g_standstill_data.rest = 0;
+    g_standstill_data.moved = false;
+    g_standstill_data.detected = false;
+    g_standstill_data.twitched = false;
+    g_standstill_data.warned = false;
+    g_standstill_data.is_spindle_stopped = io_spindle_stopped();
+    g_standstill_data.stop_requested =
+        io_output(MH400E_OUTPUT_STOP_SPINDLE, &stop_spindle);
+}
+
+static void standstill_update(double velocity, bool enable, bool twitching,
+                              double threshold, long hold, long period)
+{
+    if (!enable)
+    {
+        g_standstill_data.velocity = 0;
+        g_standstill_data.rest = 0;
+        g_standstill_data.moved = false;
+        g_standstill_data.detected = false;
+        g_standstill_data.twitched = false;
+        return;
+    }
+
+    /* first order low pass, suppresses encoder quantization noise */
+    g_standstill_data.velocity += (fabs(velocity) -
+                                   g_standstill_data.velocity) *
+        (double)period / (double)(MH400E_STANDSTILL_FILTER_TIME + period);
+
+    /* The spindle_stopped input is our cross-check: an encoder that did not
+     * show any motion while the spindle was reported to be running (i.e.
+     * it is not connected or broken) can not tell us anything. */
+    if (*g_standstill_data.is_spindle_stopped)
+    {
+        g_standstill_data.moved = false;
+        g_standstill_data.warned = false;
+    }
+    else if (g_standstill_data.velocity >= threshold)
+    {
+        g_standstill_data.moved = true;
+    }
+
+    /* Twitching pulses the spindle motor during the shift, the motion it
+     * causes must not be mistaken for a spindle that starts running */
+    if (twitching)
+    {
+        g_standstill_data.twitched = true;
+    }
+    else if (g_standstill_data.velocity < threshold)
+    {
+        g_standstill_data.twitched = false;
+    }
+
+    if (g_standstill_data.velocity >= threshold)
+    {
+        g_standstill_data.rest = 0;
+    }
+    else if (g_standstill_data.rest < hold)
+    {
+        g_standstill_data.rest = g_standstill_data.rest + period;
+    }
+
+    /* Only a spindle that we asked to stop can be at rest. The detection
+     * only bridges the time until the spindle_stopped input catches up,
+     * from then on the input alone decides, so that a spindle that starts
+     * turning during a shift still triggers the emergency stop. Motion
+     * seen by the encoder before that ends the detection as well, unless
+     * it was caused by twitching. */
+    if (!*g_standstill_data.stop_requested ||
+        *g_standstill_data.is_spindle_stopped ||
+        ((g_standstill_data.velocity >= threshold) &&
+         !g_standstill_data.twitched))
+    {
+        g_standstill_data.detected = false;
+        return;
+    }
+
+    if (g_standstill_data.detected || (g_standstill_data.rest < hold))
+    {
+        return;
+    }
+
+    if (g_standstill_data.moved)
+    {
+        g_standstill_data.detected = true;
+    }
+    else if (!*g_standstill_data.is_spindle_stopped &&
+             !g_standstill_data.warned)
+    {
+        rtapi_print_msg(RTAPI_MSG_ERR, "mh400e_gearbox: WARNING: spindle "
+                        "encoder did not show any motion, waiting for "
+                        "spindle_stopped\n");
+        g_standstill_data.warned = true;
+    }
+}
+
+static bool standstill_detected(void)
+{
+    return g_standstill_data.detected;
+}
@@ -0,0 +1,56 @@
+/*
+LinuxCNC component for controlling the MAHO MH400E gearbox.
+
+Copyright (C) 2018 Sergey 'Jin' Bostandzhyan <jin@mediatomb.cc>
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+as published by the Free Software Foundation; either version 2
+of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+*/
+
+/* Spindle standstill detection from the encoder velocity: the discrete
+ * spindle_stopped input lags behind the point where the spindle actually
+ * came to rest, the encoder tells us much earlier. */
+
+#ifndef __MH400E_STANDSTILL_H__
+#define __MH400E_STANDSTILL_H__
+
+#include <rtapi.h>
+
+#include "mh400e_common.h"
+#include "mh400e_io.h"
+#include "mh400e_timing.h"
+
+/* Call only once, sets up the global standstill detection data */
+FUNCTION(standstill_setup);
+
+/* Call this function once per thread cycle after the inputs have been
+ * read, it filters the encoder velocity and updates the detection. The
+ * spindle is at rest once the filtered velocity stayed below threshold
+ * for hold nanoseconds, the enable parameter switches the detection on.
+ * twitching tells if one of the twitch outputs is on, the encoder motion
+ * caused by it does not end the detection. */
+static void standstill_update(double velocity, bool enable, bool twitching,
+                              double threshold, long hold, long period);
+
+/* Returns true if the encoder velocity reports that the spindle came to
+ * rest while we asked it to stop and the spindle_stopped input did not
+ * catch up yet. Always false if the detection is not enabled. */
+static bool standstill_detected(void);
+
+/* really ugly way of keeping more order and splitting the sources,
+ * halcompile does not allow to link multipe source files together, so
+ * ultimately all sources need to be included by the .comp directly */
+#include "mh400e_standstill.c"
+
+#endif//__MH400E_STANDSTILL_H__
@@ -0,0 +1,109 @@
+/*
+LinuxCNC component for controlling the MAHO MH400E gearbox.
+
+Copyright (C) 2018 Sergey 'Jin' Bostandzhyan <jin@mediatomb.cc>
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+as published by the Free Software Foundation; either version 2
+of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+*/
+
+/* Implementation of the shift statistics. */
+
+#include "mh400e_stats.h"
+
+/* group statistics related data */
+static struct
+{
+    bool shifting;      /* a shift is being counted */
+    int from;           /* gear index the shift started in, -1 if unknown */
+    long long time;     /* time in ns the current shift took so far */
+    hal_u32_t *shifts_from[MH400E_NUM_GEARS];
+    hal_u32_t *shifts_to[MH400E_NUM_GEARS];
+    hal_u32_t *time_total;
+    hal_u32_t *time_max;
+    hal_u32_t *spindle_estops;
+    hal_u32_t *twitch_pulses;
+} g_stats_data;
+
+FUNCTION(stats_setup)
+{
+    int i;
+
+    for (i = 0; i < MH400E_NUM_GEARS; i++)
+    {
+        g_stats_data.shifts_from[i] = &stat_shifts_from(i);
+        g_stats_data.shifts_to[i] = &stat_shifts_to(i);
+    }
+
+    g_stats_data.shifting = false;
+    g_stats_data.from = -1;
+    g_stats_data.time = 0;
+    g_stats_data.time_total = &stat_shift_time;
+    g_stats_data.time_max = &stat_shift_time_max;
+    g_stats_data.spindle_estops = &stat_spindle_estops;
+    g_stats_data.twitch_pulses = &stat_twitch_pulses;
+}
+
+static void stats_shift_start(int from)
+{
+    g_stats_data.shifting = true;
+    g_stats_data.from = from;
+    g_stats_data.time = 0;
+}
+
+static void stats_shift_update(long period)
+{
+    g_stats_data.time += period;
+}
+
+static void stats_shift_done(int to)
+{
+    hal_u32_t ms = (hal_u32_t)(g_stats_data.time / 1000000);
+
+    if (!g_stats_data.shifting)
+    {
+        return;
+    }
+    g_stats_data.shifting = false;
+
+    if (g_stats_data.from >= 0)
+    {
+        (*g_stats_data.shifts_from[g_stats_data.from])++;
+    }
+    if (to >= 0)
+    {
+        (*g_stats_data.shifts_to[to])++;
+    }
+
+    *g_stats_data.time_total += ms;
+    if (ms > *g_stats_data.time_max)
+    {
+        *g_stats_data.time_max = ms;
+    }
+}
+
+static void stats_shift_abort(void)
+{
+    g_stats_data.shifting = false;
+}
+
+static void stats_spindle_estop(void)
+{
+    (*g_stats_data.spindle_estops)++;
+}
+
+static void stats_twitch_pulse(void)
+{
+    (*g_stats_data.twitch_pulses)++;
+}
@@ -0,0 +1,62 @@
+/*
+LinuxCNC component for controlling the MAHO MH400E gearbox.
+
+Copyright (C) 2018 Sergey 'Jin' Bostandzhyan <jin@mediatomb.cc>
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+as published by the Free Software Foundation; either version 2
+of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+*/
+
+/* Shift statistics: counters that are exported as output pins, so that
+ * they can be collected from userspace without any extra work in the
+ * realtime thread (see tools/mh400e_exporter.py). */
+
+#ifndef __MH400E_STATS_H__
+#define __MH400E_STATS_H__
+
+#include <rtapi.h>
+
+#include "mh400e_common.h"
+
+/* Call only once, sets up the global statistics data structure */
+FUNCTION(stats_setup);
+
+/* Call when a gear shift starts, from is the index of the current gear or
+ * -1 if the shafts are not in a known gear */
+static void stats_shift_start(int from);
+
+/* Call once per thread cycle while a gear shift is in progress */
+static void stats_shift_update(long period);
+
+/* Call when a gear shift has been completed, to is the index of the gear
+ * we shifted to */
+static void stats_shift_done(int to);
+
+/* Call when a gear shift was aborted by an emergency stop, it will not be
+ * counted */
+static void stats_shift_abort(void);
+
+/* Count an emergency stop that was triggered because the spindle was
+ * running during a gear shift */
+static void stats_spindle_estop(void);
+
+/* Count a twitch pulse */
+static void stats_twitch_pulse(void);
+
+/* really ugly way of keeping more order and splitting the sources,
+ * halcompile does not allow to link multipe source files together, so
+ * ultimately all sources need to be included by the .comp directly */
+#include "mh400e_stats.c"
+
+#endif//__MH400E_STATS_H__
@@ -0,0 +1,100 @@
+/*
+LinuxCNC component for controlling the MAHO MH400E gearbox.
+
+Copyright (C) 2018 Sergey 'Jin' Bostandzhyan <jin@mediatomb.cc>
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+as published by the Free Software Foundation; either version 2
+of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+*/
+
+/* Implementation of the runtime tunable timings. */
+
+#include "mh400e_timing.h"
+
+/* parameters in seconds which are backing the timings */
+static struct
+{
+    hal_float_t *twitch_on;
+    hal_float_t *twitch_off;
+    hal_float_t *stage_settle;
+    hal_float_t *reverse_motor;
+    hal_float_t *pin_interval;
+    hal_float_t *at_speed;
+} g_timing_params;
+
+/* Convert a parameter to nanoseconds, clamp it to the given limits and
+ * write a clamped value back to the parameter. The result is long long so
+ * that limits beyond the 2s range of a 32 bit long can be used as well. */
+static long long timing_convert(hal_float_t *param, long long min,
+                                long long max, const char *name)
+{
+    double ns = *param * 1000000000.0;
+
+    if (!(ns >= min)) /* also catches NaN */
+    {
+        ns = min;
+    }
+    else if (ns > max)
+    {
+        ns = max;
+    }
+    else
+    {
+        return (long long)ns;
+    }
+
+    rtapi_print_msg(RTAPI_MSG_ERR, "mh400e_gearbox: WARNING: %s is out "
+                    "of range, limiting it to %lld ms\n", name,
+                    (long long)(ns / 1000000.0));
+    *param = ns / 1000000000.0;
+    return (long long)ns;
+}
+
+FUNCTION(timing_setup)
+{
+    g_timing_params.twitch_on = &twitch_on_time;
+    g_timing_params.twitch_off = &twitch_off_time;
+    g_timing_params.stage_settle = &stage_settle_time;
+    g_timing_params.reverse_motor = &reverse_motor_time;
+    g_timing_params.pin_interval = &pin_interval_time;
+    g_timing_params.at_speed = &spindle_at_speed_time;
+
+    timing_latch();
+}
+
+static void timing_latch(void)
+{
+    g_timing.twitch_keep_pin_on = timing_convert(g_timing_params.twitch_on,
+            MH400E_TWITCH_KEEP_PIN_ON_MIN, MH400E_TWITCH_KEEP_PIN_ON_MAX,
+            "twitch-on-time");
+    g_timing.twitch_keep_pin_off = timing_convert(g_timing_params.twitch_off,
+            MH400E_TWITCH_KEEP_PIN_OFF_MIN, MH400E_TWITCH_KEEP_PIN_OFF_MAX,
+            "twitch-off-time");
+    g_timing.gear_stage_poll_interval = timing_convert(
+            g_timing_params.stage_settle,
+            MH400E_GEAR_STAGE_POLL_INTERVAL_MIN,
+            MH400E_GEAR_STAGE_POLL_INTERVAL_MAX, "stage-settle-time");
+    g_timing.reverse_motor_interval = timing_convert(
+            g_timing_params.reverse_motor,
+            MH400E_REVERSE_MOTOR_INTERVAL_MIN,
+            MH400E_REVERSE_MOTOR_INTERVAL_MAX, "reverse-motor-time");
+    g_timing.generic_pin_interval = timing_convert(
+            g_timing_params.pin_interval,
+            MH400E_GENERIC_PIN_INTERVAL_MIN,
+            MH400E_GENERIC_PIN_INTERVAL_MAX, "pin-interval-time");
+    g_timing.wait_spindle_at_speed = timing_convert(
+            g_timing_params.at_speed,
+            MH400E_WAIT_SPINDLE_AT_SPEED_MIN,
+            MH400E_WAIT_SPINDLE_AT_SPEED_MAX, "spindle-at-speed-time");
+}
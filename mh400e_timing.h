@@ -0,0 +1,56 @@
+/*
+LinuxCNC component for controlling the MAHO MH400E gearbox.
+
+Copyright (C) 2018 Sergey 'Jin' Bostandzhyan <jin@mediatomb.cc>
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+as published by the Free Software Foundation; either version 2
+of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+*/
+
+/* Gear shift timings that can be tuned at runtime via HAL parameters. */
+
+#ifndef __MH400E_TIMING_H__
+#define __MH400E_TIMING_H__
+
+#include <rtapi.h>
+
+#include "mh400e_common.h"
+
+/* Currently active timings in nanoseconds, only changed by timing_latch() */
+static struct
+{
+    long twitch_keep_pin_on;
+    long twitch_keep_pin_off;
+    long gear_stage_poll_interval;
+    long reverse_motor_interval;
+    long generic_pin_interval;
+    long wait_spindle_at_speed;
+} g_timing;
+
+/* Call only once before any other setup function, sets up the parameter
+ * pointers and latches the initial values */
+FUNCTION(timing_setup);
+
+/* Take over the current parameter values, call this function at the
+ * beginning of an operation so that the timings do not change in the
+ * middle of it. Values outside of the allowed limits are clamped, the
+ * parameter is updated accordingly. */
+static void timing_latch(void);
+
+/* really ugly way of keeping more order and splitting the sources,
+ * halcompile does not allow to link multipe source files together, so
+ * ultimately all sources need to be included by the .comp directly */
+#include "mh400e_timing.c"
+
+#endif//__MH400E_TIMING_H__
@@ -44,9 +44,9 @@ FUNCTION(twitch_setup)
    /* Initialize twitch data structure */
     g_twitch_data.want_cw = true;
     g_twitch_data.delay = 0;
-    g_twitch_data.cw = &twitch_cw;
-    g_twitch_data.ccw = &twitch_ccw;
-    g_twitch_data.trigger_estop = &estop_out;
+    g_twitch_data.cw = io_output(MH400E_OUTPUT_TWITCH_CW, &twitch_cw);
+    g_twitch_data.ccw = io_output(MH400E_OUTPUT_TWITCH_CCW, &twitch_ccw);
+    g_twitch_data.trigger_estop = io_output(MH400E_OUTPUT_ESTOP, &estop_out);
     g_twitch_data.next = twitch_stop;
     g_twitch_data.finished = true;
 }
@@ -82,7 +82,7 @@ static void twitch_stop(long period)
 
 /* Do not call this function directly, it will be setup by twitch_start().
  * Alternates between twitch_cw and twitch_ccw pins, respecting the
- * MH400E_TWITCH_KEEP_PIN_ON and MH400E_TWITCH_KEEP_PIN_OFF delays. */
+ * twitch pin on and off times from g_timing. */
 static void twitch_do(long period)
 {
     if (g_twitch_data.delay > 0)
@@ -104,8 +104,9 @@ static void twitch_do(long period)
             *g_twitch_data.ccw = true;
             g_twitch_data.want_cw = true;
         }
+        stats_twitch_pulse();
 
-        g_twitch_data.delay = MH400E_TWITCH_KEEP_PIN_ON;
+        g_twitch_data.delay = g_timing.twitch_keep_pin_on;
         g_twitch_data.next = twitch_do;
         return;
     }
@@ -114,7 +115,7 @@ static void twitch_do(long period)
 
         *g_twitch_data.cw = false;
         g_twitch_data.want_cw = false;
-        g_twitch_data.delay = MH400E_TWITCH_KEEP_PIN_OFF;
+        g_twitch_data.delay = g_timing.twitch_keep_pin_off;
         g_twitch_data.next = twitch_do;
         return;
     }
@@ -122,7 +123,7 @@ static void twitch_do(long period)
     {
         *g_twitch_data.ccw = false;
         g_twitch_data.want_cw = true;
-        g_twitch_data.delay = MH400E_TWITCH_KEEP_PIN_OFF;
+        g_twitch_data.delay = g_timing.twitch_keep_pin_off;
         g_twitch_data.next = twitch_do;
         return;
     }
@@ -175,3 +176,8 @@ static bool twitch_stop_completed(void)
 {
     return g_twitch_data.finished;
 }
+
+static bool twitch_active(void)
+{
+    return *g_twitch_data.cw || *g_twitch_data.ccw;
+}
@@ -26,6 +26,9 @@ Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
 #include <rtapi.h>
 
 #include "mh400e_common.h"
+#include "mh400e_io.h"
+#include "mh400e_stats.h"
+#include "mh400e_timing.h"
 
 /* Call only once, sets up the global twitch state data structure */
 FUNCTION(twitch_setup);
@@ -48,6 +51,9 @@ static void twitch_stop(long period);
 /* Returns true if stop twitching operation completed. */
 static bool twitch_stop_completed(void);
 
+/* Returns true while one of the twitch outputs is on */
+static bool twitch_active(void);
+
 /* really ugly way of keeping more order and splitting the sources,
  * halcompile does not allow to link multipe source files together, so
  * ultimately all sources need to be included by the .comp directly */
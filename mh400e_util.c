@@ -157,42 +157,6 @@ static tree_node_t *tree_search_closest_match(tree_node_t *root, unsigned key)
     return tree_search_closest_match(root->left, key);
 }
 
-/* Return tree node by the given key, if there is no exact match (i.e.
- * key not found), return NULL. */
-static tree_node_t *tree_search(tree_node_t *root, unsigned key)
-{
-    tree_node_t *result = tree_search_closest_match(root, key);
-    if ((result != NULL) && (result->key == key))
-    {
-        return result;
-    }
-    return NULL;
-}
-
-/* Helper function for array sorting. */
-static void swap_elements(pair_t *p1, pair_t *p2)
-{
-	pair_t tmp = *p1;
-    *p1 = *p2;
-    *p2 = tmp;
-}
-
-/* Simple bubble sort to get our gear arrays in order. */
-static void sort_array_by_key(pair_t array[], size_t length)
-{
-    int i, j;
-    for (i = 0; i < length - 1; i++)
-    {
-        for (j = 0; j < length - i - 1; j++)
-        {
-            if (array[j].key > array[j + 1].key)
-            {
-                swap_elements(&(array[j]), &(array[j + 1]));
-            }
-        }
-    }
-}
-
 static pair_t *select_gear_from_rpm(tree_node_t *tree, float rpm)
 {
     tree_node_t *result;
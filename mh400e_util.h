@@ -65,13 +65,6 @@ static tree_node_t *tree_from_sorted_array(pair_t *array, size_t length);
 static tree_node_t *tree_search_closest_match(tree_node_t *root,
                                               unsigned key);
 
-/* Return tree node by the given key, if there is no exact match (i.e.
- * key not found), return NULL. */
-static tree_node_t *tree_search(tree_node_t *root, unsigned key);
-
-/* Simple bubble sort to get our gear arrays in order. */
-static void sort_array_by_key(pair_t array[], size_t length);
-
 /* Find the closest matching gear that is supported by the MH400E.
  *
  * Everything <= 0 is matched to 0. Everything >4000 is matched to 4000,
@@ -0,0 +1,36 @@
+/*
+LinuxCNC component for controlling the MAHO MH400E gearbox.
+
+Copyright (C) 2018 Sergey 'Jin' Bostandzhyan <jin@mediatomb.cc>
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+as published by the Free Software Foundation; either version 2
+of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+*/
+
+/* Minimal stand-ins for the LinuxCNC types that are needed to build the
+ * gearbox components on the host, see hostcomp.py. */
+
+#ifndef __MH400E_HOST_H__
+#define __MH400E_HOST_H__
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+typedef volatile bool hal_bit_t;
+typedef volatile double hal_float_t;
+typedef volatile uint32_t hal_u32_t;
+typedef volatile int32_t hal_s32_t;
+
+#endif//__MH400E_HOST_H__
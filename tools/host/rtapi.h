@@ -0,0 +1,42 @@
+/*
+LinuxCNC component for controlling the MAHO MH400E gearbox.
+
+Copyright (C) 2018 Sergey 'Jin' Bostandzhyan <jin@mediatomb.cc>
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+as published by the Free Software Foundation; either version 2
+of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+*/
+
+/* Host replacement for the RTAPI header, see hostcomp.py. */
+
+#ifndef __MH400E_HOST_RTAPI_H__
+#define __MH400E_HOST_RTAPI_H__
+
+#include "mh400e_host.h"
+
+#define RTAPI_MSG_NONE  0
+#define RTAPI_MSG_ERR   1
+#define RTAPI_MSG_WARN  2
+#define RTAPI_MSG_INFO  3
+#define RTAPI_MSG_DBG   4
+#define RTAPI_MSG_ALL   5
+
+/* messages above this level are dropped, defaults to RTAPI_MSG_ERR */
+extern int host_msg_level;
+
+void rtapi_print_msg(int level, const char *fmt, ...);
+
+void *hal_malloc(long int size);
+
+#endif//__MH400E_HOST_RTAPI_H__
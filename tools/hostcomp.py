@@ -0,0 +1,162 @@
+#!/usr/bin/env python3
+#
+# LinuxCNC component for controlling the MAHO MH400E gearbox.
+#
+# Copyright (C) 2018 Sergey 'Jin' Bostandzhyan <jin@mediatomb.cc>
+#
+# This program is free software; you can redistribute it and/or
+# modify it under the terms of the GNU General Public License
+# as published by the Free Software Foundation; either version 2
+# of the License, or (at your option) any later version.
+#
+# This program is distributed in the hope that it will be useful,
+# but WITHOUT ANY WARRANTY; without even the implied warranty of
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+# GNU General Public License for more details.
+#
+# You should have received a copy of the GNU General Public License
+# along with this program; if not, write to the Free Software
+# Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+
+"""Turn a .comp file into a plain C source that can be built and run on the
+host without LinuxCNC, in a similar way as halcompile would do it.
+
+Each pin and parameter becomes a member of a "<prefix>_io" structure which
+is declared in the generated header, the host program owns the storage and
+plays the role of HAL by copying values between the structures of several
+components.
+
+Usage: hostcomp.py <file.comp> <prefix> <out.c> <out.h> [extra.c]
+
+The optional extra source is appended to the generated file, it can be used
+to access static functions of the component."""
+
+import re
+import sys
+
+TYPES = {'bit': 'hal_bit_t', 'float': 'hal_float_t', 'u32': 'hal_u32_t',
+         's32': 'hal_s32_t'}
+
+
+def parse(path):
+    """Split the .comp into its declarations and the C code."""
+    text = open(path).read()
+    head, body = text.split('\n;;\n', 1)
+    lines = head.count('\n') + 3
+    head = re.sub(r'/\*.*?\*/', '', head, flags=re.S)
+    items, options = [], {}
+    for stmt in head.split(';'):
+        stmt = ' '.join(stmt.split())
+        m = re.match(r'(pin|param)\s+(in|out|io|r|rw)\s+(\w+)\s+([\w\-#]+)'
+                     r'(?:\[(\d+)\])?(?:\s*=\s*([^\s"]+))?', stmt)
+        if m:
+            kind, direction, hal_type, name, size, default = m.groups()
+            name = name.replace('-#', '').replace('-', '_')
+            items.append((kind, direction, TYPES[hal_type], name,
+                          int(size) if size else 0, default))
+            continue
+        m = re.match(r'option\s+(\w+)\s+(\w+)', stmt)
+        if m:
+            options[m.group(1)] = m.group(2)
+    return items, options, body, lines
+
+
+def value(default):
+    return {'true': '1', 'false': '0'}.get(default, default)
+
+
+def main():
+    if len(sys.argv) not in (5, 6):
+        sys.exit(__doc__)
+    comp, prefix, out_c, out_h = sys.argv[1:5]
+    items, options, body, lines = parse(comp)
+    guard = '__%s_HOST_H__' % prefix.upper()
+
+    h = ['/* generated by hostcomp.py from %s, do not edit */' % comp,
+         '#ifndef %s' % guard,
+         '#define %s' % guard,
+         '',
+         '#include "mh400e_host.h"',
+         '',
+         'struct %s_io' % prefix,
+         '{']
+    for kind, direction, hal_type, name, size, default in items:
+        h.append('    %s %s%s;' % (hal_type, name,
+                                   '[%d]' % size if size else ''))
+    h += ['};',
+          '',
+          '/* bind the component to the given storage and set defaults */',
+          'void %s_bind(struct %s_io *io);' % (prefix, prefix),
+          '/* run one thread cycle of the component */',
+          'void %s_run(long period);' % prefix,
+          '/* call the components cleanup function, if it has one */',
+          'void %s_cleanup(void);' % prefix,
+          '',
+          '#endif//%s' % guard]
+
+    c = ['/* generated by hostcomp.py from %s, do not edit */' % comp,
+         '#include "%s"' % out_h.split('/')[-1],
+         '',
+         'struct __comp_state',
+         '{']
+    for kind, direction, hal_type, name, size, default in items:
+        c.append('    %s *%s%s;' % (hal_type, name,
+                                    '[%d]' % size if size else ''))
+    c += ['};',
+          '',
+          '#define FUNCTION(name) static void name('
+          'struct __comp_state *__comp_inst, long period)',
+          '#define EXTRA_CLEANUP() static void extra_cleanup(void)',
+          '#define fperiod (period * 1e-9)']
+    for kind, direction, hal_type, name, size, default in items:
+        # input pins can not be assigned to, just like with halcompile
+        expr = '(0+*__comp_inst->%s%s)' if direction == 'in' else \
+               '(*__comp_inst->%s%s)'
+        if size:
+            c.append('#define %s(i) %s' % (name, expr % (name, '[i]')))
+        else:
+            c.append('#define %s %s' % (name, expr % (name, '')))
+    c += ['#line %d "%s"' % (lines, comp), body]
+    if len(sys.argv) == 6:
+        c += ['#line 1 "%s"' % sys.argv[5], open(sys.argv[5]).read()]
+    for item in items:
+        c.append('#undef %s' % item[3])
+
+    c += ['',
+          'static struct __comp_state host_inst;',
+          '',
+          'void %s_bind(struct %s_io *io)' % (prefix, prefix),
+          '{',
+          '    int i = 0;',
+          '    (void)i;']
+    for kind, direction, hal_type, name, size, default in items:
+        if size:
+            c.append('    for (i = 0; i < %d; i++)' % size)
+            c.append('    {')
+            c.append('        host_inst.%s[i] = &io->%s[i];' % (name, name))
+            if default:
+                c.append('        io->%s[i] = %s;' % (name, value(default)))
+            c.append('    }')
+        else:
+            c.append('    host_inst.%s = &io->%s;' % (name, name))
+            if default:
+                c.append('    io->%s = %s;' % (name, value(default)))
+    c += ['}',
+          '',
+          'void %s_run(long period)' % prefix,
+          '{',
+          '    _(&host_inst, period);',
+          '}',
+          '',
+          'void %s_cleanup(void)' % prefix,
+          '{']
+    if options.get('extra_cleanup') == 'yes':
+        c.append('    extra_cleanup();')
+    c.append('}')
+
+    open(out_c, 'w').write('\n'.join(c) + '\n')
+    open(out_h, 'w').write('\n'.join(h) + '\n')
+
+
+if __name__ == '__main__':
+    main()
@@ -0,0 +1,127 @@
+/*
+LinuxCNC component for controlling the MAHO MH400E gearbox.
+
+Copyright (C) 2018 Sergey 'Jin' Bostandzhyan <jin@mediatomb.cc>
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+as published by the Free Software Foundation; either version 2
+of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+*/
+
+/* Shift time benchmark: runs all transitions between the supported gears
+ * against the simulator and reports shift times and motor overshoot. */
+
+#include <getopt.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include <rtapi.h>
+
+#include "mh400e_harness.h"
+#include "mh400e_common.h"
+
+/* give up on a single transition after 60s */
+#define BENCH_TIMEOUT       60000
+
+static void usage(const char *name)
+{
+    printf("Usage: %s [-p] [-i] [-s]\n"
+           "  -p  use the packed interface of the component\n"
+           "  -i  simulate spindle inertia, the time until the spindle is\n"
+           "      at speed again is included\n"
+           "  -s  detect spindle standstill from the encoder velocity\n",
+           name);
+}
+
+int main(int argc, char **argv)
+{
+    bool standstill = false;
+    int opt;
+    long total = 0;
+    long worst = 0;
+    int count = 0;
+    int failed = 0;
+    int from, to;
+    struct timespec start, end;
+    double cpu;
+
+    while ((opt = getopt(argc, argv, "pish")) != -1)
+    {
+        switch (opt)
+        {
+            case 'p': harness_packed = true; break;
+            case 'i': harness_inertia = true; break;
+            case 's': standstill = true; break;
+            default: usage(argv[0]); return (opt == 'h') ? 0 : 2;
+        }
+    }
+
+    host_msg_level = RTAPI_MSG_NONE;
+    harness_setup();
+    harness_gearbox.standstill_detect = standstill;
+
+    /* CPU time of the simulator and the component together, to compare
+     * different builds */
+    clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &start);
+
+    for (from = 0; from < MH400E_NUM_GEARS; from++)
+    {
+        for (to = 0; to < MH400E_NUM_GEARS; to++)
+        {
+            long cycles;
+
+            if (from == to)
+            {
+                continue;
+            }
+
+            if (harness_shift(mh400e_gears[from].key, BENCH_TIMEOUT,
+                              NULL) < 0)
+            {
+                failed++;
+                continue;
+            }
+
+            cycles = harness_shift(mh400e_gears[to].key, BENCH_TIMEOUT, NULL);
+            if (cycles < 0)
+            {
+                printf("%4u -> %4u rpm: FAILED\n", mh400e_gears[from].key,
+                       mh400e_gears[to].key);
+                failed++;
+                continue;
+            }
+
+            total += cycles;
+            count++;
+            if (cycles > worst)
+            {
+                worst = cycles;
+            }
+        }
+    }
+
+    clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &end);
+    cpu = (end.tv_sec - start.tv_sec) + (end.tv_nsec - start.tv_nsec) * 1e-9;
+
+    printf("%d transitions, mean %.1f ms, worst %ld ms, %d failed\n",
+           count, count ? (double)total / count : 0.0, worst, failed);
+    printf("motor overshoot: total %.1f ms, worst %.1f ms\n",
+           harness_overshoot_total * 1e-6, harness_overshoot_max * 1e-6);
+    printf("cpu time: %.3f s for %llu cycles, %.1f ns per cycle\n", cpu,
+           (unsigned long long)harness_cycles,
+           harness_cycles ? cpu * 1e9 / harness_cycles : 0.0);
+
+    return failed ? 1 : 0;
+}
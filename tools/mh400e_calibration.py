@@ -0,0 +1,104 @@
+#!/usr/bin/env python3
+#
+# LinuxCNC component for controlling the MAHO MH400E gearbox.
+#
+# Copyright (C) 2018 Sergey 'Jin' Bostandzhyan <jin@mediatomb.cc>
+#
+# This program is free software; you can redistribute it and/or
+# modify it under the terms of the GNU General Public License
+# as published by the Free Software Foundation; either version 2
+# of the License, or (at your option) any later version.
+#
+# This program is distributed in the hope that it will be useful,
+# but WITHOUT ANY WARRANTY; without even the implied warranty of
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+# GNU General Public License for more details.
+#
+# You should have received a copy of the GNU General Public License
+# along with this program; if not, write to the Free Software
+# Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+
+"""Save the results of the mh400e_gearbox shaft calibration.
+
+Run this script while HAL is still up after the calibration has finished
+(the calibrating pin went back to FALSE). The measurements are read with
+the hal python module when it is available and with halcmd otherwise and
+are written as setp commands to two files which can be sourced from
+a .hal file after the components have been loaded:
+
+  mh400e_calibration.hal      shaft travel times for the gearbox component
+  mh400e_calibration_sim.hal  shaft timings for the simulator
+
+Usage: mh400e_calibration.py [output directory]"""
+
+import os
+import subprocess
+import sys
+import time
+
+COMP = 'mh400e-gearbox'
+SIM = 'mh400e-gearbox-sim'
+ENTRIES = 12
+
+# simulator parameter <- measured gearbox parameter
+SIM_PARAMS = [('sim-latency', 'cal-latency'),
+              ('sim-segment-lc', 'cal-segment-lc'),
+              ('sim-segment-cr', 'cal-segment-cr'),
+              ('sim-center-width', 'cal-center-width')]
+
+HEADER = """# Shaft timings measured by the mh400e_gearbox calibration on %s,
+# generated by tools/mh400e_calibration.py. Values are in microseconds,
+# indices are shaft * 4 + slow * 2 + reverse with the shafts numbered
+# 0: backgear, 1: midrange, 2: input stage.
+"""
+
+
+try:
+    import hal
+
+    def getp(name):
+        return hal.get_value(name)
+except (ImportError, AttributeError):
+    def getp(name):
+        out = subprocess.check_output(['halcmd', 'getp', name])
+        value = out.decode().strip()
+        # halcmd prints bit pins as TRUE/FALSE
+        if value in ('TRUE', 'FALSE'):
+            return value == 'TRUE'
+        return int(value, 0)
+
+
+def write(path, lines):
+    with open(path, 'w') as f:
+        f.write(HEADER % time.strftime('%Y-%m-%d %H:%M'))
+        f.write('\n'.join(lines) + '\n')
+    print('wrote %s' % path)
+
+
+def main():
+    if len(sys.argv) > 2:
+        sys.exit(__doc__)
+    outdir = sys.argv[1] if len(sys.argv) == 2 else '.'
+
+    if getp('%s.calibrating' % COMP):
+        sys.exit('calibration is still in progress')
+
+    travel = [getp('%s.cal-travel-%d' % (COMP, i)) for i in range(ENTRIES)]
+    if not any(travel):
+        sys.exit('no calibration results found, set %s.calibrate first'
+                 % COMP)
+
+    write(os.path.join(outdir, 'mh400e_calibration.hal'),
+          ['setp %s.shaft-travel-time-%d %d' % (COMP, i, travel[i])
+           for i in range(ENTRIES)])
+
+    lines = []
+    for sim, cal in SIM_PARAMS:
+        lines += ['setp %s.%s-%d %d' % (SIM, sim, i,
+                                        getp('%s.%s-%d' % (COMP, cal, i)))
+                  for i in range(ENTRIES)]
+    write(os.path.join(outdir, 'mh400e_calibration_sim.hal'), lines)
+
+
+if __name__ == '__main__':
+    main()
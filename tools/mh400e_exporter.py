@@ -0,0 +1,163 @@
+#!/usr/bin/env python3
+#
+# LinuxCNC component for controlling the MAHO MH400E gearbox.
+#
+# Copyright (C) 2018 Sergey 'Jin' Bostandzhyan <jin@mediatomb.cc>
+#
+# This program is free software; you can redistribute it and/or
+# modify it under the terms of the GNU General Public License
+# as published by the Free Software Foundation; either version 2
+# of the License, or (at your option) any later version.
+#
+# This program is distributed in the hope that it will be useful,
+# but WITHOUT ANY WARRANTY; without even the implied warranty of
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+# GNU General Public License for more details.
+#
+# You should have received a copy of the GNU General Public License
+# along with this program; if not, write to the Free Software
+# Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+
+"""Export the mh400e_gearbox shift statistics in the Prometheus text format.
+
+The counters are read from the stat-* output pins of the gearbox component,
+so the realtime thread does not do anything for the export. The values are
+read directly from HAL shared memory with the hal python module when it is
+available and with halcmd otherwise. The metrics can be served on a local
+Unix socket (every connection gets the current values) or written to a file
+for the node exporter textfile collector; -c is a minimal scraper that reads
+the metrics from such a socket.
+
+Usage: mh400e_exporter.py -s SOCKET | -f FILE [-i INTERVAL]
+       mh400e_exporter.py -c SOCKET"""
+
+import getopt
+import os
+import socket
+import subprocess
+import sys
+import time
+
+COMP = 'mh400e-gearbox'
+PREFIX = 'mh400e_gearbox'
+
+# gear speeds in the order of the gear table (MH400E_GEARBOX_GEARS in
+# mh400e_common.h), the stat-shifts-from/to pins are indexed the same way.
+# Keep this in sync with the table, the gearbox component checks its pin
+# array sizes at compile time.
+GEARS = [0, 80, 100, 125, 160, 200, 250, 315, 400, 500, 630, 800, 1000,
+         1250, 1600, 2000, 2500, 3150, 4000]
+
+# metric name, type, pin, scale, help
+SINGLE = [('shift_seconds_total', 'counter', 'stat-shift-time', 0.001,
+           'Cumulative time of all completed gear shifts.'),
+          ('shift_seconds_max', 'gauge', 'stat-shift-time-max', 0.001,
+           'Time of the longest completed gear shift.'),
+          ('shaft_restarts_total', 'counter', 'shaft-restarts', 1,
+           'Shaft movements that missed their target and were repeated.'),
+          ('spindle_estops_total', 'counter', 'stat-spindle-estops', 1,
+           'Emergency stops triggered by a running spindle while shifting.'),
+          ('twitch_pulses_total', 'counter', 'stat-twitch-pulses', 1,
+           'Spindle motor twitch pulses.')]
+
+# metric name, pin, help
+PER_GEAR = [('shifts_from_total', 'stat-shifts-from',
+             'Completed gear shifts by the gear they started in.'),
+            ('shifts_to_total', 'stat-shifts-to',
+             'Completed gear shifts by the gear they ended in.')]
+
+try:
+    import hal
+
+    def getp(name):
+        return hal.get_value(name)
+except (ImportError, AttributeError):
+    def getp(name):
+        out = subprocess.check_output(['halcmd', 'getp', name])
+        return int(out.decode().strip(), 0)
+
+
+def metrics():
+    lines = []
+    for name, pin, text in PER_GEAR:
+        lines.append('# HELP %s_%s %s' % (PREFIX, name, text))
+        lines.append('# TYPE %s_%s counter' % (PREFIX, name))
+        for i, rpm in enumerate(GEARS):
+            value = getp('%s.%s-%d' % (COMP, pin, i))
+            lines.append('%s_%s{rpm="%d"} %d' % (PREFIX, name, rpm, value))
+    for name, kind, pin, scale, text in SINGLE:
+        value = getp('%s.%s' % (COMP, pin))
+        lines.append('# HELP %s_%s %s' % (PREFIX, name, text))
+        lines.append('# TYPE %s_%s %s' % (PREFIX, name, kind))
+        if scale == 1:
+            lines.append('%s_%s %d' % (PREFIX, name, value))
+        else:
+            lines.append('%s_%s %.3f' % (PREFIX, name, value * scale))
+    return '\n'.join(lines) + '\n'
+
+
+def serve(path):
+    if os.path.exists(path):
+        os.unlink(path)
+    server = socket.socket(socket.AF_UNIX, socket.SOCK_STREAM)
+    server.bind(path)
+    server.listen(1)
+    try:
+        while True:
+            conn, _ = server.accept()
+            try:
+                conn.sendall(metrics().encode())
+            except (OSError, subprocess.CalledProcessError) as e:
+                print('export failed: %s' % e, file=sys.stderr)
+            finally:
+                conn.close()
+    finally:
+        server.close()
+        os.unlink(path)
+
+
+def write(path, interval):
+    # write to a temporary file first, so readers never see a partial file
+    tmp = path + '.tmp'
+    while True:
+        with open(tmp, 'w') as f:
+            f.write(metrics())
+        os.rename(tmp, path)
+        time.sleep(interval)
+
+
+def scrape(path):
+    client = socket.socket(socket.AF_UNIX, socket.SOCK_STREAM)
+    client.connect(path)
+    data = b''
+    while True:
+        chunk = client.recv(4096)
+        if not chunk:
+            break
+        data += chunk
+    client.close()
+    sys.stdout.write(data.decode())
+
+
+def main():
+    try:
+        opts, args = getopt.getopt(sys.argv[1:], 's:f:i:c:')
+    except getopt.GetoptError:
+        sys.exit(__doc__)
+    opts = dict(opts)
+    if args or len(set(opts) & {'-s', '-f', '-c'}) != 1:
+        sys.exit(__doc__)
+
+    try:
+        if '-c' in opts:
+            scrape(opts['-c'])
+        elif '-s' in opts:
+            serve(opts['-s'])
+        else:
+            write(opts['-f'], float(opts.get('-i', '10')))
+    except KeyboardInterrupt:
+        pass
+
+
+if __name__ == '__main__':
+    main()
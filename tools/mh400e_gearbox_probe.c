@@ -0,0 +1,34 @@
+/*
+LinuxCNC component for controlling the MAHO MH400E gearbox.
+
+Copyright (C) 2018 Sergey 'Jin' Bostandzhyan <jin@mediatomb.cc>
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+as published by the Free Software Foundation; either version 2
+of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+*/
+
+/* Access to static gearbox internals for the host tools, this file is
+ * appended to the generated gearbox source by hostcomp.py. */
+
+bool mh400e_gearbox_shifting(void)
+{
+    return gearshift_in_progress();
+}
+
+/* Target mask of the given shaft, shafts are numbered in the same order
+ * as their sensor inputs: backgear, midrange, input stage */
+unsigned mh400e_gearbox_target_mask(int shaft)
+{
+    return g_gearbox_data.shafts[shaft].target_mask;
+}
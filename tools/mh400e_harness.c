@@ -0,0 +1,321 @@
+/*
+LinuxCNC component for controlling the MAHO MH400E gearbox.
+
+Copyright (C) 2018 Sergey 'Jin' Bostandzhyan <jin@mediatomb.cc>
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+as published by the Free Software Foundation; either version 2
+of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+*/
+
+/* Host harness that runs the gearbox component against the gearbox
+ * simulator, see mh400e_harness.h */
+
+#include "mh400e_harness.h"
+#include "mh400e_common.h"
+
+/* implemented in mh400e_gearbox_probe.c */
+bool mh400e_gearbox_shifting(void);
+unsigned mh400e_gearbox_target_mask(int shaft);
+
+struct mh400e_gearbox_io harness_gearbox;
+struct mh400e_gearbox_sim_io harness_sim;
+
+unsigned harness_noise = 0;
+bool harness_packed = false;
+bool harness_inertia = false;
+uint64_t harness_cycles = 0;
+long long harness_overshoot_total = 0;
+long long harness_overshoot_max = 0;
+
+static hal_bit_t *g_sensors_sim[HARNESS_NUM_SENSORS];
+static hal_bit_t *g_sensors_gearbox[HARNESS_NUM_SENSORS];
+
+/* overshoot of the current shaft movement */
+static long long g_overshoot = 0;
+
+/* invariant checker state */
+static long long g_shift_time = 0;
+static bool g_last_reverse = false;
+static bool g_last_motor = false;
+
+static const char *g_invariant_names[HARNESS_NUM_INVARIANTS] =
+{
+    "ok",
+    "twitch_cw and twitch_ccw are both on",
+    "shaft motor on while the spindle is running",
+    "more than one shaft motor is on",
+    "reverse direction changed while a shaft motor is on",
+    "start_gear_shift is on outside of a gear shift",
+    "gear shift is stuck"
+};
+
+void harness_setup(void)
+{
+    int i = 0;
+
+#define HARNESS_SENSOR(name) \
+    g_sensors_sim[i] = &harness_sim.name; \
+    g_sensors_gearbox[i++] = &harness_gearbox.name;
+    HARNESS_SENSOR(reducer_left)
+    HARNESS_SENSOR(reducer_right)
+    HARNESS_SENSOR(reducer_center)
+    HARNESS_SENSOR(reducer_left_center)
+    HARNESS_SENSOR(middle_left)
+    HARNESS_SENSOR(middle_right)
+    HARNESS_SENSOR(middle_center)
+    HARNESS_SENSOR(middle_left_center)
+    HARNESS_SENSOR(input_left)
+    HARNESS_SENSOR(input_right)
+    HARNESS_SENSOR(input_center)
+    HARNESS_SENSOR(input_left_center)
+#undef HARNESS_SENSOR
+
+    mh400e_gearbox_bind(&harness_gearbox);
+    mh400e_gearbox_sim_bind(&harness_sim);
+
+    harness_gearbox.packed_io = harness_packed;
+
+    /* run the simulated shafts at realistic speed */
+    harness_sim.sim_slow_motion = false;
+
+    if (harness_inertia)
+    {
+        harness_sim.sim_stop_latency = HARNESS_STOP_LATENCY;
+        harness_sim.sim_coast_time = HARNESS_COAST_TIME;
+        harness_sim.sim_stopped_delay = HARNESS_STOPPED_DELAY;
+        harness_sim.sim_twitch_velocity = HARNESS_TWITCH_VELOCITY;
+        /* higher speeds take longer to reach */
+        for (i = 0; i < MH400E_NUM_GEARS; i++)
+        {
+            harness_sim.sim_runup_time[i] = HARNESS_RUNUP_TIME *
+                (0.2 + 0.8 * mh400e_gears[i].key / MH400E_MAX_RPM);
+        }
+    }
+}
+
+void harness_request(float rpm)
+{
+    harness_sim.sim_speed_request_in = rpm;
+    harness_sim.sim_apply_speed = true;
+}
+
+/* Signals going from the simulator to the gearbox component */
+static void harness_net_sim(void)
+{
+    int i;
+
+    for (i = 0; i < HARNESS_NUM_SENSORS; i++)
+    {
+        *g_sensors_gearbox[i] = *g_sensors_sim[i] ^ ((harness_noise >> i) & 1);
+    }
+
+    harness_gearbox.spindle_stopped = harness_sim.spindle_stopped;
+    harness_gearbox.spindle_velocity = harness_sim.spindle_velocity;
+
+    /* same wiring as with the mh400e_pack helper component */
+    if (harness_packed)
+    {
+        unsigned word = 0;
+        for (i = 0; i < HARNESS_NUM_SENSORS; i++)
+        {
+            word |= *g_sensors_gearbox[i] << i;
+        }
+        word |= harness_gearbox.spindle_stopped << MH400E_INPUT_SPINDLE_STOPPED;
+        harness_gearbox.sensors_in = word;
+    }
+    harness_gearbox.spindle_speed_in_abs = harness_sim.spindle_speed_out_abs;
+    harness_gearbox.estop_in = harness_sim.estop_out;
+}
+
+/* Signals going from the gearbox component to the simulator */
+static void harness_net_gearbox(void)
+{
+    /* unpack into the discrete pins, so that the invariant checks work
+     * the same way in both modes */
+    if (harness_packed)
+    {
+        hal_u32_t word = harness_gearbox.controls_out;
+        harness_gearbox.motor_lowspeed =
+            (word >> MH400E_OUTPUT_MOTOR_LOWSPEED) & 1;
+        harness_gearbox.reducer_motor =
+            (word >> MH400E_OUTPUT_REDUCER_MOTOR) & 1;
+        harness_gearbox.midrange_motor =
+            (word >> MH400E_OUTPUT_MIDRANGE_MOTOR) & 1;
+        harness_gearbox.input_stage_motor =
+            (word >> MH400E_OUTPUT_INPUT_STAGE_MOTOR) & 1;
+        harness_gearbox.reverse_direction =
+            (word >> MH400E_OUTPUT_REVERSE_DIRECTION) & 1;
+        harness_gearbox.start_gear_shift =
+            (word >> MH400E_OUTPUT_START_GEAR_SHIFT) & 1;
+        harness_gearbox.twitch_cw = (word >> MH400E_OUTPUT_TWITCH_CW) & 1;
+        harness_gearbox.twitch_ccw = (word >> MH400E_OUTPUT_TWITCH_CCW) & 1;
+    }
+
+    harness_sim.motor_lowspeed = harness_gearbox.motor_lowspeed;
+    harness_sim.reducer_motor = harness_gearbox.reducer_motor;
+    harness_sim.midrange_motor = harness_gearbox.midrange_motor;
+    harness_sim.input_stage_motor = harness_gearbox.input_stage_motor;
+    harness_sim.reverse_direction = harness_gearbox.reverse_direction;
+    harness_sim.start_gear_shift = harness_gearbox.start_gear_shift;
+    harness_sim.twitch_cw = harness_gearbox.twitch_cw;
+    harness_sim.twitch_ccw = harness_gearbox.twitch_ccw;
+    harness_sim.sim_stop_spindle_comp = harness_gearbox.stop_spindle;
+    harness_sim.sim_estop_comp = harness_gearbox.estop_out;
+}
+
+/* Measure how long a motor keeps running after the simulated shaft
+ * reached the target */
+static void harness_overshoot(void)
+{
+    hal_bit_t *motors[3] =
+    {
+        &harness_gearbox.reducer_motor,
+        &harness_gearbox.midrange_motor,
+        &harness_gearbox.input_stage_motor
+    };
+    int shaft;
+
+    for (shaft = 0; shaft < 3; shaft++)
+    {
+        unsigned mask = 0;
+        int i;
+
+        if (!*motors[shaft])
+        {
+            continue;
+        }
+
+        for (i = 0; i < 4; i++)
+        {
+            mask |= *g_sensors_sim[shaft * 4 + i] << i;
+        }
+
+        if (mask == mh400e_gearbox_target_mask(shaft))
+        {
+            g_overshoot += HARNESS_PERIOD;
+            harness_overshoot_total += HARNESS_PERIOD;
+            if (g_overshoot > harness_overshoot_max)
+            {
+                harness_overshoot_max = g_overshoot;
+            }
+            return;
+        }
+    }
+
+    g_overshoot = 0;
+}
+
+void harness_cycle(void)
+{
+    mh400e_gearbox_sim_run(HARNESS_PERIOD);
+    harness_sim.sim_apply_speed = false;
+    harness_net_sim();
+    mh400e_gearbox_run(HARNESS_PERIOD);
+    harness_net_gearbox();
+    harness_overshoot();
+    harness_cycles++;
+}
+
+bool harness_shifting(void)
+{
+    return mh400e_gearbox_shifting();
+}
+
+harness_invariant_t harness_check(void)
+{
+    struct mh400e_gearbox_io *g = &harness_gearbox;
+    int motors = g->reducer_motor + g->midrange_motor + g->input_stage_motor;
+    bool estop = g->estop_in || g->estop_out;
+    harness_invariant_t result = HARNESS_OK;
+
+    if (harness_shifting() && !g->estop_in)
+    {
+        g_shift_time += HARNESS_PERIOD;
+    }
+    else
+    {
+        g_shift_time = 0;
+    }
+
+    if (g->twitch_cw && g->twitch_ccw)
+    {
+        result = HARNESS_TWITCH_BOTH;
+    }
+    /* the component may only react by triggering an e-stop */
+    else if ((motors > 0) && !g->spindle_stopped && !g->spindle_standstill &&
+             !estop)
+    {
+        result = HARNESS_MOTOR_SPINDLE;
+    }
+    else if (motors > 1)
+    {
+        result = HARNESS_MOTORS_MULTIPLE;
+    }
+    else if (g_last_motor && (motors > 0) &&
+             (g->reverse_direction != g_last_reverse))
+    {
+        result = HARNESS_REVERSE_RUNNING;
+    }
+    else if (g->start_gear_shift && !harness_shifting() && !g->estop_in)
+    {
+        result = HARNESS_SHIFT_PIN;
+    }
+    else if (g_shift_time > HARNESS_MAX_SHIFT_TIME)
+    {
+        result = HARNESS_SHIFT_STUCK;
+    }
+
+    g_last_reverse = g->reverse_direction;
+    g_last_motor = (motors > 0);
+
+    return result;
+}
+
+long harness_shift(unsigned rpm, long timeout,
+                   harness_invariant_t *violation)
+{
+    harness_invariant_t invariant = HARNESS_OK;
+    long cycles = 0;
+
+    harness_request((float)rpm);
+
+    do
+    {
+        harness_cycle();
+        cycles++;
+        invariant = harness_check();
+    }
+    while ((invariant == HARNESS_OK) &&
+           !((harness_gearbox.spindle_speed_out == rpm) &&
+            !harness_shifting() &&
+            (harness_gearbox.spindle_at_speed || (rpm == 0)) &&
+            (!harness_inertia || harness_sim.sim_at_speed || (rpm == 0))) &&
+           (cycles < timeout));
+
+    if (violation != NULL)
+    {
+        *violation = invariant;
+    }
+
+    return ((invariant == HARNESS_OK) && (cycles < timeout)) ? cycles : -1;
+}
+
+const char *harness_invariant_name(harness_invariant_t invariant)
+{
+    if ((invariant < 0) || (invariant >= HARNESS_NUM_INVARIANTS))
+    {
+        return "unknown";
+    }
+    return g_invariant_names[invariant];
+}
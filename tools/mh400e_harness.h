@@ -0,0 +1,116 @@
+/*
+LinuxCNC component for controlling the MAHO MH400E gearbox.
+
+Copyright (C) 2018 Sergey 'Jin' Bostandzhyan <jin@mediatomb.cc>
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+as published by the Free Software Foundation; either version 2
+of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+*/
+
+/* Host harness that runs the gearbox component against the gearbox
+ * simulator in the same way as mh400e_gearbox_sim.hal wires them up, but
+ * without the UI and without LinuxCNC. */
+
+#ifndef __MH400E_HARNESS_H__
+#define __MH400E_HARNESS_H__
+
+#include <stdint.h>
+
+#include "mh400e_gearbox_host.h"
+#include "mh400e_gearbox_sim_host.h"
+
+/* thread period, same as in mh400e_gearbox_sim.hal */
+#define HARNESS_PERIOD          1000000L /* 1ms in nanoseconds */
+
+/* A shift that takes longer than this is considered to be stuck */
+#define HARNESS_MAX_SHIFT_TIME  60000000000LL /* 60s in nanoseconds */
+
+/* typical spindle timings in seconds used with harness_inertia, the run up
+ * time is the one to the maximum speed */
+#define HARNESS_STOP_LATENCY    0.05
+#define HARNESS_COAST_TIME      2.0
+#define HARNESS_STOPPED_DELAY   0.3
+#define HARNESS_RUNUP_TIME      1.0
+
+/* encoder velocity in revolutions per second caused by a twitch pulse */
+#define HARNESS_TWITCH_VELOCITY 0.5
+
+/* number of gearbox sensor inputs */
+#define HARNESS_NUM_SENSORS     12
+
+/* Invariants checked by harness_check() */
+typedef enum
+{
+    HARNESS_OK,
+    HARNESS_TWITCH_BOTH,        /* twitch_cw and twitch_ccw are both on */
+    HARNESS_MOTOR_SPINDLE,      /* shaft motor on while spindle running */
+    HARNESS_MOTORS_MULTIPLE,    /* more than one shaft motor is on */
+    HARNESS_REVERSE_RUNNING,    /* reverse pin changed with motor on */
+    HARNESS_SHIFT_PIN,          /* start_gear_shift set outside a shift */
+    HARNESS_SHIFT_STUCK,        /* gear shift did not finish */
+    HARNESS_NUM_INVARIANTS
+} harness_invariant_t;
+
+/* pin storage of both components, the "HAL" of the harness */
+extern struct mh400e_gearbox_io harness_gearbox;
+extern struct mh400e_gearbox_sim_io harness_sim;
+
+/* Each set bit flips the corresponding gearbox sensor input, bits are
+ * numbered the same way as the MESA 7i84 inputs. */
+extern unsigned harness_noise;
+
+/* Connect the gearbox component via its packed sensors_in and controls_out
+ * pins instead of the discrete ones, must be set before harness_setup() */
+extern bool harness_packed;
+
+/* Simulate spindle inertia with typical timings: the spindle takes a
+ * while to stop and to run up again and the twitch pulses move the
+ * encoder, harness_shift() also waits for the simulated spindle to reach
+ * the speed of the new gear. Must be set before harness_setup(). */
+extern bool harness_inertia;
+
+/* Number of cycles the harness has run so far */
+extern uint64_t harness_cycles;
+
+/* Overshoot statistics: time in ns a shaft motor was still energized while
+ * the simulated shaft was already at its target position */
+extern long long harness_overshoot_total;
+extern long long harness_overshoot_max;
+
+/* Bind the components, must be called once before anything else */
+void harness_setup(void);
+
+/* Request a new spindle speed, the same as pressing "apply" in the UI */
+void harness_request(float rpm);
+
+/* Run one thread cycle: the simulator, then the gearbox component */
+void harness_cycle(void);
+
+/* Returns true while the gearbox component is shifting */
+bool harness_shifting(void);
+
+/* Check all invariants after a cycle */
+harness_invariant_t harness_check(void);
+
+/* Request the given speed and run until the gearbox reports it with the
+ * spindle at speed (with harness_inertia also the simulated spindle). Returns the number of cycles this took or -1 on
+ * timeout or invariant violation, the violated invariant is stored in
+ * violation if it is not NULL. */
+long harness_shift(unsigned rpm, long timeout,
+                   harness_invariant_t *violation);
+
+/* Human readable description of an invariant */
+const char *harness_invariant_name(harness_invariant_t invariant);
+
+#endif//__MH400E_HARNESS_H__
@@ -0,0 +1,119 @@
+#!/usr/bin/env python3
+#
+# LinuxCNC component for controlling the MAHO MH400E gearbox.
+#
+# Copyright (C) 2018 Sergey 'Jin' Bostandzhyan <jin@mediatomb.cc>
+#
+# This program is free software; you can redistribute it and/or
+# modify it under the terms of the GNU General Public License
+# as published by the Free Software Foundation; either version 2
+# of the License, or (at your option) any later version.
+#
+# This program is distributed in the hope that it will be useful,
+# but WITHOUT ANY WARRANTY; without even the implied warranty of
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+# GNU General Public License for more details.
+#
+# You should have received a copy of the GNU General Public License
+# along with this program; if not, write to the Free Software
+# Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+
+"""Save the mh400e_gearbox state for a warm restart.
+
+The gearbox component shows the last confirmed gear, the sensor masks, the
+target of a shift in progress and the last speed request on its snapshot-*
+pins. This script saves them as restore-* parameters together with the
+shift timings and the calibrated shaft travel times, so that the state can
+be restored when the component is loaded again. Source the file after
+loading the component and before starting the thread; on the first cycle
+the component checks the snapshot against the sensors and either carries
+on in the saved gear, continues an interrupted shift or ignores it.
+
+Run it right before the component is unloaded, or with -i to refresh the
+file periodically. The file is replaced atomically.
+
+Usage: mh400e_snapshot.py [-i INTERVAL] FILE"""
+
+import getopt
+import os
+import subprocess
+import sys
+import time
+
+COMP = 'mh400e-gearbox'
+VERSION = 1     # MH400E_SNAPSHOT_VERSION in mh400e_common.h
+ENTRIES = 12
+
+SNAPSHOT = ['version', 'gear', 'target', 'masks', 'request']
+
+TUNABLES = ['twitch-on-time', 'twitch-off-time', 'stage-settle-time',
+            'reverse-motor-time', 'pin-interval-time',
+            'spindle-at-speed-time'] + \
+           ['shaft-travel-time-%d' % i for i in range(ENTRIES)]
+
+HEADER = """# mh400e_gearbox state snapshot taken on %s,
+# generated by tools/mh400e_snapshot.py. Source this file after loading the
+# component and before starting the thread.
+"""
+
+try:
+    import hal
+
+    def getp(name):
+        return str(hal.get_value(name))
+except (ImportError, AttributeError):
+    def getp(name):
+        out = subprocess.check_output(['halcmd', 'getp', name])
+        return out.decode().strip()
+
+
+def snapshot():
+    # the pins are read one by one, start over if a shift started or ended
+    # in the meantime
+    while True:
+        values = [getp('%s.snapshot-%s' % (COMP, name)) for name in SNAPSHOT]
+        if values[1:3] == [getp('%s.snapshot-%s' % (COMP, name))
+                           for name in SNAPSHOT[1:3]]:
+            return values
+
+
+def save(path):
+    values = snapshot()
+    if int(values[0]) != VERSION:
+        sys.exit('unsupported snapshot version %s' % values[0])
+
+    lines = ['setp %s.restore-%s %s' % (COMP, name, value)
+             for name, value in zip(SNAPSHOT, values)]
+    lines += ['setp %s.%s %s' % (COMP, name, getp('%s.%s' % (COMP, name)))
+              for name in TUNABLES]
+
+    # write to a temporary file first, so that we never leave a partial
+    # snapshot behind
+    tmp = path + '.tmp'
+    with open(tmp, 'w') as f:
+        f.write(HEADER % time.strftime('%Y-%m-%d %H:%M:%S'))
+        f.write('\n'.join(lines) + '\n')
+    os.rename(tmp, path)
+
+
+def main():
+    try:
+        opts, args = getopt.getopt(sys.argv[1:], 'i:')
+    except getopt.GetoptError:
+        sys.exit(__doc__)
+    if len(args) != 1:
+        sys.exit(__doc__)
+    opts = dict(opts)
+
+    try:
+        while True:
+            save(args[0])
+            if '-i' not in opts:
+                break
+            time.sleep(float(opts['-i']))
+    except KeyboardInterrupt:
+        pass
+
+
+if __name__ == '__main__':
+    main()
@@ -0,0 +1,506 @@
+/*
+LinuxCNC component for controlling the MAHO MH400E gearbox.
+
+Copyright (C) 2018 Sergey 'Jin' Bostandzhyan <jin@mediatomb.cc>
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+as published by the Free Software Foundation; either version 2
+of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+*/
+
+/* Randomized soak test: feeds random speed requests, spindle stops,
+ * emergency stops and sensor noise into the gearbox component running
+ * against the simulator and checks the invariants from mh400e_harness.h
+ * after every cycle.
+ *
+ * Each run is executed in its own process so that it starts from a clean
+ * component state, runs are spread over all CPU cores. When an invariant
+ * is violated, the input sequence of the failing run is reduced to a
+ * minimal sequence that still triggers the violation and printed. */
+
+#include <getopt.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/wait.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <rtapi.h>
+
+#include "mh400e_harness.h"
+#include "mh400e_common.h"
+
+/* Cycles per run, 1000s of simulated machine time */
+#define SOAK_DEFAULT_CYCLES     1000000
+/* Maximum number of cycles between two random events */
+#define SOAK_MAX_EVENT_GAP      3000
+/* Maximum number of cycles a noise event lasts */
+#define SOAK_MAX_NOISE_CYCLES   20
+
+typedef enum
+{
+    EVENT_SPEED,        /* value: requested rpm */
+    EVENT_STOP_SPINDLE, /* value: state of the "stop spindle" UI checkbox */
+    EVENT_ESTOP,        /* value: state of the e-stop UI button */
+    EVENT_NOISE         /* value: sensor bit | cycles << 8 */
+} event_type_t;
+
+typedef struct
+{
+    uint32_t cycle;
+    event_type_t type;
+    uint32_t value;
+} event_t;
+
+typedef struct
+{
+    harness_invariant_t invariant;
+    uint64_t cycle;
+} result_t;
+
+/* xorshift64* random number generator, each run has its own seed */
+static uint64_t random_next(uint64_t *state)
+{
+    *state ^= *state >> 12;
+    *state ^= *state << 25;
+    *state ^= *state >> 27;
+    return *state * 2685821657736338717ULL;
+}
+
+static unsigned random_range(uint64_t *state, unsigned range)
+{
+    return (unsigned)((random_next(state) >> 33) % range);
+}
+
+/* Generate the random input sequence for one run */
+static size_t generate_events(uint64_t seed, uint32_t cycles,
+                              event_t **events)
+{
+    uint64_t state = seed * 0x9e3779b97f4a7c15ULL + 1;
+    size_t count = 0;
+    size_t size = 1024;
+    uint32_t cycle = 0;
+    bool stop = false;
+    bool estop = false;
+
+    *events = malloc(size * sizeof(event_t));
+
+    while (1)
+    {
+        event_t e;
+        unsigned dice = random_range(&state, 100);
+
+        cycle += 1 + random_range(&state, SOAK_MAX_EVENT_GAP);
+        if (cycle >= cycles)
+        {
+            break;
+        }
+
+        e.cycle = cycle;
+        if (dice < 50)
+        {
+            e.type = EVENT_SPEED;
+            /* mostly supported speeds, but also arbitrary values */
+            e.value = (dice < 40) ?
+                mh400e_gears[random_range(&state, MH400E_NUM_GEARS)].key :
+                random_range(&state, 4500);
+        }
+        else if (dice < 65)
+        {
+            stop = !stop;
+            e.type = EVENT_STOP_SPINDLE;
+            e.value = stop;
+        }
+        else if (dice < 70 || estop)
+        {
+            /* e-stops are released again by the next event */
+            estop = !estop;
+            e.type = EVENT_ESTOP;
+            e.value = estop;
+        }
+        else
+        {
+            e.type = EVENT_NOISE;
+            e.value = random_range(&state, HARNESS_NUM_SENSORS) |
+                      ((1 + random_range(&state, SOAK_MAX_NOISE_CYCLES)) << 8);
+        }
+
+        if (count == size)
+        {
+            size = size * 2;
+            *events = realloc(*events, size * sizeof(event_t));
+        }
+        (*events)[count++] = e;
+    }
+
+    return count;
+}
+
+static void apply_event(const event_t *e, uint32_t *noise_end,
+                        unsigned *noise_bits)
+{
+    switch (e->type)
+    {
+        case EVENT_SPEED:
+            harness_request((float)e->value);
+            break;
+        case EVENT_STOP_SPINDLE:
+            harness_sim.sim_stop_spindle_gui = e->value;
+            break;
+        case EVENT_ESTOP:
+            harness_sim.sim_estop_gui = e->value;
+            break;
+        case EVENT_NOISE:
+            *noise_bits |= 1 << (e->value & 0xff);
+            *noise_end = e->cycle + (e->value >> 8);
+            break;
+    }
+}
+
+/* Run the given sequence from a clean component state, stops at the first
+ * invariant violation */
+static result_t run_events(const event_t *events, size_t count,
+                           uint32_t cycles)
+{
+    result_t result = { HARNESS_OK, 0 };
+    uint32_t noise_end = 0;
+    unsigned noise_bits = 0;
+    size_t next = 0;
+    uint32_t cycle;
+
+    harness_setup();
+
+    for (cycle = 0; cycle < cycles; cycle++)
+    {
+        while ((next < count) && (events[next].cycle == cycle))
+        {
+            apply_event(&events[next++], &noise_end, &noise_bits);
+        }
+
+        if (cycle >= noise_end)
+        {
+            noise_bits = 0;
+        }
+        harness_noise = noise_bits;
+
+        harness_cycle();
+
+        result.invariant = harness_check();
+        if (result.invariant != HARNESS_OK)
+        {
+            result.cycle = cycle;
+            return result;
+        }
+    }
+
+    result.cycle = cycles;
+    return result;
+}
+
+/* Components keep their state in static variables, so each run has to be
+ * executed in a fresh process */
+static result_t run_isolated(const event_t *events, size_t count,
+                             uint32_t cycles)
+{
+    result_t result = { HARNESS_OK, 0 };
+    int fds[2];
+    pid_t pid;
+
+    if (pipe(fds) != 0)
+    {
+        perror("pipe");
+        exit(2);
+    }
+
+    pid = fork();
+    if (pid < 0)
+    {
+        perror("fork");
+        exit(2);
+    }
+
+    if (pid == 0)
+    {
+        close(fds[0]);
+        host_msg_level = RTAPI_MSG_NONE;
+        result = run_events(events, count, cycles);
+        if (write(fds[1], &result, sizeof(result)) != sizeof(result))
+        {
+            _exit(2);
+        }
+        _exit(0);
+    }
+
+    close(fds[1]);
+    if (read(fds[0], &result, sizeof(result)) != sizeof(result))
+    {
+        fprintf(stderr, "soak run crashed\n");
+        result.invariant = HARNESS_NUM_INVARIANTS;
+    }
+    close(fds[0]);
+    waitpid(pid, NULL, 0);
+
+    return result;
+}
+
+/* Reduce the failing sequence by removing chunks of events as long as
+ * the same invariant is still violated (delta debugging) */
+static size_t shrink_events(event_t *events, size_t count, uint32_t *cycles,
+                            harness_invariant_t invariant)
+{
+    event_t *candidate = malloc((count + 1) * sizeof(event_t));
+    size_t chunks = 2;
+
+    while (count > 0)
+    {
+        size_t chunk = (count + chunks - 1) / chunks;
+        bool reduced = false;
+        size_t start;
+
+        for (start = 0; start < count; start += chunk)
+        {
+            size_t end = (start + chunk < count) ? start + chunk : count;
+            size_t n = count - (end - start);
+            result_t result;
+
+            memcpy(candidate, events, start * sizeof(event_t));
+            memcpy(candidate + start, events + end,
+                   (count - end) * sizeof(event_t));
+
+            result = run_isolated(candidate, n, *cycles);
+            if (result.invariant == invariant)
+            {
+                memcpy(events, candidate, n * sizeof(event_t));
+                count = n;
+                *cycles = result.cycle + 1;
+                reduced = true;
+                break;
+            }
+        }
+
+        if (reduced)
+        {
+            chunks = (chunks > 2) ? chunks - 1 : 2;
+        }
+        else if (chunk == 1)
+        {
+            break;
+        }
+        else
+        {
+            chunks = (chunks * 2 < count) ? chunks * 2 : count;
+        }
+    }
+
+    free(candidate);
+    return count;
+}
+
+static void print_events(const event_t *events, size_t count)
+{
+    size_t i;
+    for (i = 0; i < count; i++)
+    {
+        const event_t *e = &events[i];
+        switch (e->type)
+        {
+            case EVENT_SPEED:
+                printf("  cycle %8u: request %u rpm\n", e->cycle, e->value);
+                break;
+            case EVENT_STOP_SPINDLE:
+                printf("  cycle %8u: stop spindle %s\n", e->cycle,
+                       e->value ? "on" : "off");
+                break;
+            case EVENT_ESTOP:
+                printf("  cycle %8u: e-stop %s\n", e->cycle,
+                       e->value ? "on" : "off");
+                break;
+            case EVENT_NOISE:
+                printf("  cycle %8u: flip sensor input %u for %u cycles\n",
+                       e->cycle, e->value & 0xff, e->value >> 8);
+                break;
+        }
+    }
+}
+
+/* Worker process, runs random sequences until the time is up or a
+ * violation was found. Returns the number of cycles executed. */
+static uint64_t soak_worker(int job, uint64_t seed, uint32_t cycles,
+                            time_t deadline, bool *failed)
+{
+    uint64_t total = 0;
+    uint64_t run;
+
+    for (run = 0; (deadline == 0) || (time(NULL) < deadline); run++)
+    {
+        uint64_t run_seed = seed + ((uint64_t)job << 40) + run;
+        event_t *events;
+        size_t count = generate_events(run_seed, cycles, &events);
+        result_t result = run_isolated(events, count, cycles);
+
+        total += result.cycle;
+
+        if (result.invariant != HARNESS_OK)
+        {
+            uint32_t fail_cycles = (uint32_t)result.cycle + 1;
+
+            printf("job %d: seed %llu violated invariant \"%s\" at cycle "
+                   "%llu, shrinking input...\n", job,
+                   (unsigned long long)run_seed,
+                   harness_invariant_name(result.invariant),
+                   (unsigned long long)result.cycle);
+            fflush(stdout);
+
+            count = shrink_events(events, count, &fail_cycles,
+                                  result.invariant);
+            printf("job %d: minimal sequence for seed %llu, \"%s\" at "
+                   "cycle %u:\n", job, (unsigned long long)run_seed,
+                   harness_invariant_name(result.invariant),
+                   fail_cycles - 1);
+            print_events(events, count);
+            fflush(stdout);
+            free(events);
+            *failed = true;
+            return total;
+        }
+        free(events);
+    }
+
+    return total;
+}
+
+static void usage(const char *name)
+{
+    printf("Usage: %s [-j jobs] [-s seed] [-n cycles] [-t seconds] [-p]\n"
+           "  -j jobs     number of parallel workers (default: all cores)\n"
+           "  -s seed     base seed (default: current time)\n"
+           "  -n cycles   cycles of 1ms per run (default: %d)\n"
+           "  -t seconds  soak duration, 0 runs until a violation is "
+           "found (default: 10)\n"
+           "  -p          use the packed interface of the component\n", name, SOAK_DEFAULT_CYCLES);
+}
+
+int main(int argc, char **argv)
+{
+    long jobs = sysconf(_SC_NPROCESSORS_ONLN);
+    uint64_t seed = (uint64_t)time(NULL);
+    uint32_t cycles = SOAK_DEFAULT_CYCLES;
+    long seconds = 10;
+    int fds[2];
+    pid_t *workers;
+    struct timespec start, end;
+    uint64_t total = 0;
+    bool failed = false;
+    double elapsed;
+    int opt;
+    long i;
+
+    while ((opt = getopt(argc, argv, "j:s:n:t:ph")) != -1)
+    {
+        switch (opt)
+        {
+            case 'j': jobs = atol(optarg); break;
+            case 's': seed = strtoull(optarg, NULL, 0); break;
+            case 'n': cycles = (uint32_t)atol(optarg); break;
+            case 't': seconds = atol(optarg); break;
+            case 'p': harness_packed = true; break;
+            default: usage(argv[0]); return (opt == 'h') ? 0 : 2;
+        }
+    }
+
+    if (jobs < 1)
+    {
+        jobs = 1;
+    }
+
+    printf("soaking with %ld jobs, seed %llu, %u cycles per run\n", jobs,
+           (unsigned long long)seed, cycles);
+    fflush(stdout);
+
+    if (pipe(fds) != 0)
+    {
+        perror("pipe");
+        return 2;
+    }
+
+    workers = calloc(jobs, sizeof(pid_t));
+
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    for (i = 0; i < jobs; i++)
+    {
+        workers[i] = fork();
+        if (workers[i] == 0)
+        {
+            time_t deadline = (seconds > 0) ? time(NULL) + seconds : 0;
+            uint64_t done;
+            bool job_failed = false;
+
+            close(fds[0]);
+            done = soak_worker((int)i, seed, cycles, deadline, &job_failed);
+            if (write(fds[1], &done, sizeof(done)) != sizeof(done))
+            {
+                _exit(2);
+            }
+            _exit(job_failed ? 1 : 0);
+        }
+    }
+    close(fds[1]);
+
+    for (i = 0; i < jobs; i++)
+    {
+        int status;
+        long j;
+        pid_t pid = wait(&status);
+
+        if (WIFEXITED(status) && (WEXITSTATUS(status) == 0))
+        {
+            continue;
+        }
+
+        /* first failure ends the soak for everybody */
+        if (!failed)
+        {
+            for (j = 0; j < jobs; j++)
+            {
+                if (workers[j] != pid)
+                {
+                    kill(workers[j], SIGTERM);
+                }
+            }
+        }
+        failed = true;
+    }
+
+    /* collect the cycle counts of all workers that finished their runs */
+    while (1)
+    {
+        uint64_t done;
+        if (read(fds[0], &done, sizeof(done)) != sizeof(done))
+        {
+            break;
+        }
+        total += done;
+    }
+    free(workers);
+    clock_gettime(CLOCK_MONOTONIC, &end);
+
+    elapsed = (end.tv_sec - start.tv_sec) +
+              (end.tv_nsec - start.tv_nsec) * 1e-9;
+    printf("%llu cycles in %.1fs, %.2f million cycles per second: %s\n",
+           (unsigned long long)total, elapsed, total / elapsed / 1e6,
+           failed ? "FAILED" : "passed");
+
+    return failed ? 1 : 0;
+}
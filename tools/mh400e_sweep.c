@@ -0,0 +1,493 @@
+/*
+LinuxCNC component for controlling the MAHO MH400E gearbox.
+
+Copyright (C) 2018 Sergey 'Jin' Bostandzhyan <jin@mediatomb.cc>
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+as published by the Free Software Foundation; either version 2
+of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+*/
+
+/* Parameter sweep for the gear shift timings: runs all transitions between
+ * the supported gears against the simulator for many combinations of the
+ * timing parameters and prints the settings that are not beaten by any
+ * other setting in both mean and worst shift time (the Pareto front).
+ *
+ * Each configuration runs in its own process so that it starts from a
+ * clean component state, configurations are spread over all CPU cores.
+ * Keep in mind that the simulator does not model the mechanics of the
+ * real gearbox, the results are a starting point for tuning on the
+ * machine and not a replacement for it. */
+
+#include <getopt.h>
+#include <math.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/wait.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <rtapi.h>
+
+#include "mh400e_harness.h"
+#include "mh400e_common.h"
+
+/* give up on a single transition after 60s */
+#define SWEEP_TIMEOUT           60000
+/* number of random configurations if no grid is requested */
+#define SWEEP_DEFAULT_CONFIGS   200
+
+/* A timing parameter of the gearbox component, limits in seconds */
+typedef struct
+{
+    const char *name;
+    size_t offset;      /* of the parameter in struct mh400e_gearbox_io */
+    double min;
+    double max;
+} sweep_param_t;
+
+#define SWEEP_PARAM(name, min, max) \
+    { #name, offsetof(struct mh400e_gearbox_io, name), \
+      (min) * 1e-9, (max) * 1e-9 }
+
+/* the spindle wait may be 0, but a log scale needs a lower limit */
+static const sweep_param_t g_params[] =
+{
+    SWEEP_PARAM(pin_interval_time, MH400E_GENERIC_PIN_INTERVAL_MIN,
+                MH400E_GENERIC_PIN_INTERVAL_MAX),
+    SWEEP_PARAM(stage_settle_time, MH400E_GEAR_STAGE_POLL_INTERVAL_MIN,
+                MH400E_GEAR_STAGE_POLL_INTERVAL_MAX),
+    SWEEP_PARAM(reverse_motor_time, MH400E_REVERSE_MOTOR_INTERVAL_MIN,
+                MH400E_REVERSE_MOTOR_INTERVAL_MAX),
+    SWEEP_PARAM(twitch_on_time, MH400E_TWITCH_KEEP_PIN_ON_MIN,
+                MH400E_TWITCH_KEEP_PIN_ON_MAX),
+    SWEEP_PARAM(twitch_off_time, MH400E_TWITCH_KEEP_PIN_OFF_MIN,
+                MH400E_TWITCH_KEEP_PIN_OFF_MAX),
+    SWEEP_PARAM(spindle_at_speed_time, 1000000L,
+                MH400E_WAIT_SPINDLE_AT_SPEED_MAX)
+};
+
+#define SWEEP_NUM_PARAMS    (sizeof(g_params)/sizeof(g_params[0]))
+
+typedef struct
+{
+    hal_float_t value[SWEEP_NUM_PARAMS];
+} config_t;
+
+typedef struct
+{
+    long index;             /* of the configuration */
+    int count;              /* completed transitions */
+    int failed;             /* timed out transitions */
+    int violations;         /* transitions that violated an invariant */
+    harness_invariant_t invariant;  /* first violated invariant */
+    double mean;            /* ms */
+    long worst;             /* ms */
+} result_t;
+
+/* xorshift64* random number generator */
+static uint64_t random_next(uint64_t *state)
+{
+    *state ^= *state >> 12;
+    *state ^= *state << 25;
+    *state ^= *state >> 27;
+    return *state * 2685821657736338717ULL;
+}
+
+static double random_unit(uint64_t *state)
+{
+    return (double)(random_next(state) >> 11) / (double)(1ULL << 53);
+}
+
+/* Parameter values are spread on a log scale, the interesting settings
+ * are at the lower end of the ranges */
+static double param_value(const sweep_param_t *param, double position)
+{
+    return param->min * pow(param->max / param->min, position);
+}
+
+/* Configuration 0 always holds the component defaults as a reference */
+static void default_config(config_t *config)
+{
+    struct mh400e_gearbox_io io;
+    size_t i;
+
+    memset(&io, 0, sizeof(io));
+    mh400e_gearbox_bind(&io);
+    for (i = 0; i < SWEEP_NUM_PARAMS; i++)
+    {
+        config->value[i] =
+            *(hal_float_t *)((char *)&io + g_params[i].offset);
+    }
+}
+
+static long generate_configs(config_t **configs, long count, int steps,
+                             uint64_t seed)
+{
+    uint64_t state = seed * 0x9e3779b97f4a7c15ULL + 1;
+    long i;
+    size_t j;
+
+    if (steps > 1)
+    {
+        count = 1;
+        for (j = 0; j < SWEEP_NUM_PARAMS; j++)
+        {
+            count *= steps;
+        }
+    }
+
+    *configs = malloc((count + 1) * sizeof(config_t));
+    default_config(&(*configs)[0]);
+
+    for (i = 0; i < count; i++)
+    {
+        long grid = i;
+        for (j = 0; j < SWEEP_NUM_PARAMS; j++)
+        {
+            double position;
+            if (steps > 1)
+            {
+                position = (double)(grid % steps) / (steps - 1);
+                grid /= steps;
+            }
+            else
+            {
+                position = random_unit(&state);
+            }
+            (*configs)[i + 1].value[j] = param_value(&g_params[j], position);
+        }
+    }
+
+    return count + 1;
+}
+
+/* Run all transitions with the given configuration */
+static result_t run_config(const config_t *config, long index)
+{
+    result_t result;
+    long total = 0;
+    int from, to;
+    size_t i;
+
+    memset(&result, 0, sizeof(result));
+    result.index = index;
+
+    harness_setup();
+    for (i = 0; i < SWEEP_NUM_PARAMS; i++)
+    {
+        *(hal_float_t *)((char *)&harness_gearbox + g_params[i].offset) =
+            config->value[i];
+    }
+
+    for (from = 0; from < MH400E_NUM_GEARS; from++)
+    {
+        for (to = 0; to < MH400E_NUM_GEARS; to++)
+        {
+            harness_invariant_t invariant;
+            long cycles;
+
+            if (from == to)
+            {
+                continue;
+            }
+
+            cycles = harness_shift(mh400e_gears[from].key, SWEEP_TIMEOUT,
+                                   &invariant);
+            if (cycles >= 0)
+            {
+                cycles = harness_shift(mh400e_gears[to].key, SWEEP_TIMEOUT,
+                                       &invariant);
+            }
+
+            if (cycles < 0)
+            {
+                if (invariant != HARNESS_OK)
+                {
+                    if (result.violations++ == 0)
+                    {
+                        result.invariant = invariant;
+                    }
+                    /* the configuration is out, no need to go on */
+                    return result;
+                }
+                result.failed++;
+                continue;
+            }
+
+            total += cycles;
+            result.count++;
+            if (cycles > result.worst)
+            {
+                result.worst = cycles;
+            }
+        }
+    }
+
+    result.mean = result.count ? (double)total / result.count : 0.0;
+    return result;
+}
+
+/* Components keep their state in static variables, so each configuration
+ * is run in a fresh process which reports its result through the pipe */
+static pid_t start_config(const config_t *config, long index, int fd)
+{
+    pid_t pid = fork();
+
+    if (pid < 0)
+    {
+        perror("fork");
+        exit(2);
+    }
+
+    if (pid == 0)
+    {
+        result_t result;
+
+        host_msg_level = RTAPI_MSG_NONE;
+        result = run_config(config, index);
+        /* results are smaller than PIPE_BUF, so writes are atomic */
+        if (write(fd, &result, sizeof(result)) != sizeof(result))
+        {
+            _exit(2);
+        }
+        _exit(0);
+    }
+
+    return pid;
+}
+
+static bool result_valid(const result_t *result)
+{
+    return (result->violations == 0) && (result->failed == 0) &&
+           (result->count > 0);
+}
+
+/* true if a is at least as good as b in both mean and worst time and
+ * better in one of them */
+static bool result_dominates(const result_t *a, const result_t *b)
+{
+    return (a->mean <= b->mean) && (a->worst <= b->worst) &&
+           ((a->mean < b->mean) || (a->worst < b->worst));
+}
+
+static int result_compare_mean(const void *a, const void *b)
+{
+    const result_t *ra = a;
+    const result_t *rb = b;
+
+    if (ra->mean != rb->mean)
+    {
+        return (ra->mean < rb->mean) ? -1 : 1;
+    }
+    return (ra->worst < rb->worst) ? -1 : (ra->worst > rb->worst);
+}
+
+static void print_header(void)
+{
+    size_t i;
+
+    printf("%8s %9s %7s", "config", "mean ms", "worst");
+    for (i = 0; i < SWEEP_NUM_PARAMS; i++)
+    {
+        printf(" %*s", (int)strlen(g_params[i].name), g_params[i].name);
+    }
+    printf("\n");
+}
+
+static void print_result(const result_t *result, const config_t *configs)
+{
+    size_t i;
+
+    if (result->index == 0)
+    {
+        printf("%8s", "default");
+    }
+    else
+    {
+        printf("%8ld", result->index);
+    }
+
+    if (result_valid(result))
+    {
+        printf(" %9.1f %7ld", result->mean, result->worst);
+    }
+    else if (result->violations > 0)
+    {
+        printf(" %17s", "violation");
+    }
+    else
+    {
+        printf(" %17s", "failed");
+    }
+
+    for (i = 0; i < SWEEP_NUM_PARAMS; i++)
+    {
+        printf(" %*.4f", (int)strlen(g_params[i].name),
+               configs[result->index].value[i]);
+    }
+    printf("\n");
+}
+
+static void usage(const char *name)
+{
+    printf("Usage: %s [-j jobs] [-s seed] [-n configs] [-g steps] [-a] [-p]\n"
+           "  -j jobs     number of parallel runs (default: all cores)\n"
+           "  -s seed     seed of the random search (default: current time)\n"
+           "  -n configs  number of random configurations (default: %d)\n"
+           "  -g steps    search a grid with the given number of steps per "
+           "parameter instead\n"
+           "  -a          print all results, not only the Pareto front\n"
+           "  -p          use the packed interface of the component\n",
+           name, SWEEP_DEFAULT_CONFIGS);
+}
+
+int main(int argc, char **argv)
+{
+    long jobs = sysconf(_SC_NPROCESSORS_ONLN);
+    uint64_t seed = (uint64_t)time(NULL);
+    long count = SWEEP_DEFAULT_CONFIGS;
+    int steps = 0;
+    bool all = false;
+    config_t *configs;
+    result_t *results;
+    long started = 0;
+    long running = 0;
+    long done = 0;
+    long valid = 0;
+    long i, j;
+    int fds[2];
+    int opt;
+
+    while ((opt = getopt(argc, argv, "j:s:n:g:aph")) != -1)
+    {
+        switch (opt)
+        {
+            case 'j': jobs = atol(optarg); break;
+            case 's': seed = strtoull(optarg, NULL, 0); break;
+            case 'n': count = atol(optarg); break;
+            case 'g': steps = atoi(optarg); break;
+            case 'a': all = true; break;
+            case 'p': harness_packed = true; break;
+            default: usage(argv[0]); return (opt == 'h') ? 0 : 2;
+        }
+    }
+
+    if (jobs < 1)
+    {
+        jobs = 1;
+    }
+
+    count = generate_configs(&configs, (count > 0) ? count : 0, steps, seed);
+    results = calloc(count, sizeof(result_t));
+
+    printf("sweeping %ld configurations with %ld jobs, ", count, jobs);
+    if (steps > 1)
+    {
+        printf("grid with %d steps per parameter\n", steps);
+    }
+    else
+    {
+        printf("seed %llu\n", (unsigned long long)seed);
+    }
+    fflush(stdout);
+
+    if (pipe(fds) != 0)
+    {
+        perror("pipe");
+        return 2;
+    }
+
+    /* keep all cores busy until every configuration has been run */
+    while (done < count)
+    {
+        result_t result;
+
+        while ((running < jobs) && (started < count))
+        {
+            start_config(&configs[started], started, fds[1]);
+            started++;
+            running++;
+        }
+
+        if (read(fds[0], &result, sizeof(result)) != sizeof(result))
+        {
+            perror("read");
+            return 2;
+        }
+        wait(NULL);
+        running--;
+
+        results[result.index] = result;
+        done++;
+        valid += result_valid(&result);
+    }
+
+    qsort(results, count, sizeof(result_t), result_compare_mean);
+
+    printf("%ld of %ld configurations passed all transitions without "
+           "violating an invariant\n", valid, count);
+    if (all)
+    {
+        print_header();
+        for (i = 0; i < count; i++)
+        {
+            print_result(&results[i], configs);
+        }
+        printf("\n");
+    }
+
+    printf("Pareto front (mean vs. worst shift time):\n");
+    print_header();
+    for (i = 0; i < count; i++)
+    {
+        bool dominated = false;
+
+        if (!result_valid(&results[i]))
+        {
+            continue;
+        }
+
+        for (j = 0; (j < count) && !dominated; j++)
+        {
+            dominated = result_valid(&results[j]) &&
+                        result_dominates(&results[j], &results[i]);
+        }
+
+        if (!dominated)
+        {
+            print_result(&results[i], configs);
+        }
+    }
+
+    /* the reference */
+    for (i = 0; i < count; i++)
+    {
+        if (results[i].index == 0)
+        {
+            printf("\ndefaults for reference:\n");
+            print_result(&results[i], configs);
+            if (results[i].violations > 0)
+            {
+                printf("violated \"%s\"\n",
+                       harness_invariant_name(results[i].invariant));
+            }
+        }
+    }
+
+    free(results);
+    free(configs);
+    return 0;
+}